@@ -0,0 +1,119 @@
+/*  RogueNaRok is an algorithm for the identification of rogue taxa in a set of phylogenetic trees. 
+ *
+ *  Moreover, the program collection comes with efficient implementations of 
+ *   * the unrooted leaf stability by Thorley and Wilkinson
+ *   * the taxonomic instability index by Maddinson and Maddison
+ *   * a maximum agreement subtree implementation (MAST) for unrooted trees 
+ *   * a tool for pruning taxa from a tree collection. 
+ * 
+ *  Copyright October 2011 by Andre J. Aberer
+ * 
+ *  Tree I/O and parallel framework are derived from RAxML by Alexandros Stamatakis.
+ *
+ *  This program is free software; you may redistribute it and/or
+ *  modify its under the terms of the GNU General Public License as
+ *  published by the Free Software Foundation; either version 2 of the
+ *  License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  For any other inquiries send an Email to Andre J. Aberer
+ *  andre.aberer at googlemail.com
+ * 
+ *  When publishing work that is based on the results from RogueNaRok, please cite:
+ *  Andre J. Aberer, Denis Krompaß, Alexandros Stamatakis. RogueNaRok: an Efficient and Exact Algorithm for Rogue Taxon Identification. (unpublished) 2011. 
+ * 
+ */
+
+#include "Arena.h"
+
+/* the objects are aligned as by malloc (at least for the structures
+   of this program) */
+#define ARENA_ALIGNMENT 8
+#define ALIGN_IN_ARENA(x) (((x) + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1))
+#define CHUNK_HEADER_SIZE ALIGN_IN_ARENA(sizeof(ArenaChunk))
+
+
+static ArenaChunk *createChunk(size_t size, ArenaChunk *next)
+{
+  ArenaChunk
+    *result = malloc(CHUNK_HEADER_SIZE + size);
+
+  assert(result);
+  result->next = next;
+  result->size = size;
+  result->used = 0;
+
+  return result;
+}
+
+
+Arena *createArena(size_t chunkSize)
+{
+  Arena
+    *result = CALLOC(1, sizeof(Arena));
+
+  result->chunkSize = ALIGN_IN_ARENA(MAX(chunkSize, 1024));
+
+  return result;
+}
+
+
+/* the memory is zeroed (as by CALLOC) */
+void *arenaAlloc(Arena *arena, size_t size)
+{
+  ArenaChunk
+    *chunk = arena->chunks;
+
+  void
+    *result;
+
+  size = ALIGN_IN_ARENA(size);
+
+  if( NOT chunk || chunk->used + size > chunk->size)
+    {
+      /* later chunks get larger, s.t. there only are a few of them */
+      if(chunk)
+        arena->chunkSize *= 2;
+      chunk = arena->chunks = createChunk(MAX(arena->chunkSize, size), chunk);
+    }
+
+  result = (char*)chunk + CHUNK_HEADER_SIZE + chunk->used;
+  chunk->used += size;
+  memset(result, 0, size);
+
+  return result;
+}
+
+
+/* releases all objects, only the last (largest) chunk is kept */
+void clearArena(Arena *arena)
+{
+  ArenaChunk
+    *iter;
+
+  if( NOT arena->chunks)
+    return;
+
+  iter = arena->chunks->next;
+  while(iter)
+    {
+      ArenaChunk *next = iter->next;
+      free(iter);
+      iter = next;
+    }
+
+  arena->chunks->next = NULL;
+  arena->chunks->used = 0;
+}
+
+
+void destroyArena(Arena *arena)
+{
+  clearArena(arena);
+  free(arena->chunks);
+  free(arena);
+}
@@ -31,7 +31,6 @@
 #include "BitVector.h"
 
 BitVector *mask32;
-char bits_in_16bits [0x1u << 16];
 
 void initializeMask(void)
 {
@@ -79,51 +78,635 @@ boolean areSameBitVectors(BitVector *a, BitVector *b, int bitVectorLength)
 }
 
 
-BitVector genericBitCount(BitVector* bitVector, int bitVectorLength)
+/* bit vector kernels: the words are processed in 64-bit lanes (two
+   words at a time) with a hardware popcount. On x86 an AVX2 or AVX-512
+   variant is chosen at runtime, the portable variant is used
+   otherwise. All variants return the same counts. */
+
+static inline uint64_t loadLane(const BitVector *p)
 {
+  uint64_t
+    result;
+
+  memcpy(&result, p, sizeof(uint64_t));
+  return result;
+}
+
+
+/* xorBitCount and xnorBitCount stop counting once limit is exceeded */
+#define DEFINE_SCALAR_KERNELS(SUFFIX, ATTRIBUTE)                        \
+  ATTRIBUTE static int bitCount##SUFFIX(const BitVector *a, int length) \
+  {                                                                     \
+    int i, result = 0;                                                  \
+    for(i = 0; i + 1 < length; i += 2)                                  \
+      result += __builtin_popcountll(loadLane(a + i));                  \
+    if(i < length)                                                      \
+      result += __builtin_popcount(a[i]);                               \
+    return result;                                                      \
+  }                                                                     \
+                                                                        \
+  ATTRIBUTE static int xorBitCount##SUFFIX(const BitVector *a, const BitVector *b, \
+                                           int length, int limit)       \
+  {                                                                     \
+    int i, result = 0;                                                  \
+    for(i = 0; i + 1 < length && result <= limit; i += 2)               \
+      result += __builtin_popcountll(loadLane(a + i) ^ loadLane(b + i)); \
+    if(i < length && result <= limit)                                   \
+      result += __builtin_popcount(a[i] ^ b[i]);                        \
+    return result;                                                      \
+  }                                                                     \
+                                                                        \
+  ATTRIBUTE static int xnorBitCount##SUFFIX(const BitVector *a, const BitVector *b, \
+                                            const BitVector *maskA, const BitVector *maskB, \
+                                            int length, int limit)      \
+  {                                                                     \
+    int i, result = 0;                                                  \
+    for(i = 0; i + 1 < length && result <= limit; i += 2)               \
+      result += __builtin_popcountll(~((loadLane(a + i) ^ loadLane(b + i)) \
+                                       | loadLane(maskA + i) | loadLane(maskB + i))); \
+    if(i < length && result <= limit)                                   \
+      result += __builtin_popcount(~((a[i] ^ b[i]) | maskA[i] | maskB[i])); \
+    return result;                                                      \
+  }                                                                     \
+                                                                        \
+  ATTRIBUTE static void differenceBitCounts##SUFFIX(const BitVector *a, const BitVector *b, \
+                                                    const BitVector *maskA, const BitVector *maskB, \
+                                                    int length, int limit, \
+                                                    int *xorCount, int *xnorCount) \
+  {                                                                     \
+    int i, x = 0, y = 0;                                                \
+    for(i = 0; i + 1 < length && (x <= limit || y <= limit); i += 2)    \
+      {                                                                 \
+        uint64_t difference = loadLane(a + i) ^ loadLane(b + i);        \
+        x += __builtin_popcountll(difference);                          \
+        y += __builtin_popcountll(~(difference | loadLane(maskA + i) | loadLane(maskB + i))); \
+      }                                                                 \
+    if(i < length && (x <= limit || y <= limit))                        \
+      {                                                                 \
+        x += __builtin_popcount(a[i] ^ b[i]);                           \
+        y += __builtin_popcount(~((a[i] ^ b[i]) | maskA[i] | maskB[i])); \
+      }                                                                 \
+    *xorCount = x;                                                      \
+    *xnorCount = y;                                                     \
+  }
+
+DEFINE_SCALAR_KERNELS(Portable, )
+
+
+/* the taxa in neither mask split a into three parts: its intersection
+   with b and the differences. The splits are compatible, if one of
+   them is empty. */
+static boolean compatibleBitVectorsGeneric(const BitVector *a, const BitVector *b,
+                                           const BitVector *maskA, const BitVector *maskB,
+                                           int length)
+{
+  int
+    i;
+
   BitVector
+    both = 0,
+    onlyA = 0,
+    onlyB = 0;
+
+  FOR_0_LIMIT(i, length)
+    {
+      BitVector
+        valid = ~(maskA[i] | maskB[i]);
+
+      both |= a[i] & b[i] & valid;
+      onlyA |= a[i] & ~b[i] & valid;
+      onlyB |= ~a[i] & b[i] & valid;
+
+      if(both && onlyA && onlyB)
+        return FALSE;
+    }
+
+  return TRUE;
+}
+
+
+static void complementBitVectorGeneric(BitVector *a, const BitVector *maskA, const BitVector *maskB, int length)
+{
+  int
+    i;
+
+  FOR_0_LIMIT(i, length)
+    a[i] = ~(a[i] | maskA[i] | maskB[i]);
+}
+
+
+/* kernels for a fixed number of words (a multiple of 2), the loops
+   are unrolled completely and the lanes of the masks stay in
+   registers */
+#define DEFINE_FIXED_WIDTH_KERNELS(WORDS, SUFFIX, ATTRIBUTE)            \
+  ATTRIBUTE static int xorBitCount##WORDS##SUFFIX(const BitVector *a, const BitVector *b, \
+                                                  int length, int limit) \
+  {                                                                     \
+    int i, result = 0;                                                  \
+    assert(length == WORDS);                                            \
+    (void)limit;                                                        \
+    for(i = 0; i < WORDS; i += 2)                                       \
+      result += __builtin_popcountll(loadLane(a + i) ^ loadLane(b + i)); \
+    return result;                                                      \
+  }                                                                     \
+                                                                        \
+  ATTRIBUTE static int xnorBitCount##WORDS##SUFFIX(const BitVector *a, const BitVector *b, \
+                                                   const BitVector *maskA, const BitVector *maskB, \
+                                                   int length, int limit) \
+  {                                                                     \
+    int i, result = 0;                                                  \
+    assert(length == WORDS);                                            \
+    (void)limit;                                                        \
+    for(i = 0; i < WORDS; i += 2)                                       \
+      result += __builtin_popcountll(~((loadLane(a + i) ^ loadLane(b + i)) \
+                                       | loadLane(maskA + i) | loadLane(maskB + i))); \
+    return result;                                                      \
+  }                                                                     \
+                                                                        \
+  ATTRIBUTE static void differenceBitCounts##WORDS##SUFFIX(const BitVector *a, const BitVector *b, \
+                                                           const BitVector *maskA, const BitVector *maskB, \
+                                                           int length, int limit, \
+                                                           int *xorCount, int *xnorCount) \
+  {                                                                     \
+    int i, x = 0, y = 0;                                                \
+    assert(length == WORDS);                                            \
+    (void)limit;                                                        \
+    for(i = 0; i < WORDS; i += 2)                                       \
+      {                                                                 \
+        uint64_t difference = loadLane(a + i) ^ loadLane(b + i);        \
+        x += __builtin_popcountll(difference);                          \
+        y += __builtin_popcountll(~(difference | loadLane(maskA + i) | loadLane(maskB + i))); \
+      }                                                                 \
+    *xorCount = x;                                                      \
+    *xnorCount = y;                                                     \
+  }                                                                     \
+                                                                        \
+  ATTRIBUTE static boolean compatibleBitVectors##WORDS##SUFFIX(const BitVector *a, const BitVector *b, \
+                                                               const BitVector *maskA, const BitVector *maskB, \
+                                                               int length) \
+  {                                                                     \
+    int i;                                                              \
+    uint64_t both = 0, onlyA = 0, onlyB = 0;                            \
+    assert(length == WORDS);                                            \
+    for(i = 0; i < WORDS; i += 2)                                       \
+      {                                                                 \
+        uint64_t                                                        \
+          x = loadLane(a + i),                                          \
+          y = loadLane(b + i),                                          \
+          valid = ~(loadLane(maskA + i) | loadLane(maskB + i));         \
+        both |= x & y & valid;                                          \
+        onlyA |= x & ~y & valid;                                        \
+        onlyB |= ~x & y & valid;                                        \
+      }                                                                 \
+    return NOT both || NOT onlyA || NOT onlyB;                          \
+  }                                                                     \
+                                                                        \
+  ATTRIBUTE static void complementBitVector##WORDS##SUFFIX(BitVector *a, const BitVector *maskA, \
+                                                           const BitVector *maskB, int length) \
+  {                                                                     \
+    int i;                                                              \
+    assert(length == WORDS);                                            \
+    for(i = 0; i < WORDS; ++i)                                          \
+      a[i] = ~(a[i] | maskA[i] | maskB[i]);                             \
+  }
+
+#define DEFINE_ALL_FIXED_WIDTH_KERNELS(SUFFIX, ATTRIBUTE)       \
+  DEFINE_FIXED_WIDTH_KERNELS(2, SUFFIX, ATTRIBUTE)              \
+  DEFINE_FIXED_WIDTH_KERNELS(4, SUFFIX, ATTRIBUTE)              \
+  DEFINE_FIXED_WIDTH_KERNELS(8, SUFFIX, ATTRIBUTE)              \
+  DEFINE_FIXED_WIDTH_KERNELS(16, SUFFIX, ATTRIBUTE)
+
+DEFINE_ALL_FIXED_WIDTH_KERNELS(Portable, )
+
+static boolean
+  hasPopcnt = FALSE;
+
+/* kernels chosen for the cpu */
+static int (*bitCountKernel)(const BitVector*, int) = bitCountPortable;
+static int (*xorBitCountCpu)(const BitVector*, const BitVector*, int, int) = xorBitCountPortable;
+static int (*xnorBitCountCpu)(const BitVector*, const BitVector*, const BitVector*, const BitVector*, int, int) = xnorBitCountPortable;
+static void (*differenceBitCountsCpu)(const BitVector*, const BitVector*, const BitVector*, const BitVector*, int, int, int*, int*) = differenceBitCountsPortable;
+
+/* kernels chosen for the cpu and the width of the taxon vectors */
+static int (*xorBitCountKernel)(const BitVector*, const BitVector*, int, int) = xorBitCountPortable;
+static int (*xnorBitCountKernel)(const BitVector*, const BitVector*, const BitVector*, const BitVector*, int, int) = xnorBitCountPortable;
+static void (*differenceBitCountsKernel)(const BitVector*, const BitVector*, const BitVector*, const BitVector*, int, int, int*, int*) = differenceBitCountsPortable;
+static boolean (*compatibleKernel)(const BitVector*, const BitVector*, const BitVector*, const BitVector*, int) = compatibleBitVectorsGeneric;
+static void (*complementKernel)(BitVector*, const BitVector*, const BitVector*, int) = complementBitVectorGeneric;
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define X86_KERNELS
+#include <immintrin.h>
+
+DEFINE_SCALAR_KERNELS(Popcnt, __attribute__((target("popcnt"))))
+DEFINE_ALL_FIXED_WIDTH_KERNELS(Popcnt, __attribute__((target("popcnt"))))
+
+
+/* popcount of the bytes by nibble lookup, summed up per 64-bit lane */
+__attribute__((target("avx2")))
+static inline __m256i popcountAvx2(__m256i v)
+{
+  const __m256i
+    lookup = _mm256_setr_epi8(0,1,1,2,1,2,2,3,1,2,2,3,2,3,3,4,
+                              0,1,1,2,1,2,2,3,1,2,2,3,2,3,3,4),
+    low = _mm256_set1_epi8(0x0f);
+
+  __m256i
+    counts = _mm256_add_epi8(_mm256_shuffle_epi8(lookup, _mm256_and_si256(v, low)),
+                             _mm256_shuffle_epi8(lookup, _mm256_and_si256(_mm256_srli_epi16(v, 4), low)));
+
+  return _mm256_sad_epu8(counts, _mm256_setzero_si256());
+}
+
+
+__attribute__((target("avx2")))
+static inline int sumLanesAvx2(__m256i v)
+{
+  __m128i
+    s = _mm_add_epi64(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+
+  return (int)(_mm_cvtsi128_si64(s) + _mm_extract_epi64(s, 1));
+}
+
+
+__attribute__((target("avx2,popcnt")))
+static int bitCountAvx2(const BitVector *a, int length)
+{
+  int
+    i;
+
+  __m256i
+    sum = _mm256_setzero_si256();
+
+  for(i = 0; i + 8 <= length; i += 8)
+    sum = _mm256_add_epi64(sum, popcountAvx2(_mm256_loadu_si256((const __m256i*)(a + i))));
+
+  return sumLanesAvx2(sum) + bitCountPopcnt(a + i, length - i);
+}
+
+
+__attribute__((target("avx2,popcnt")))
+static int xorBitCountAvx2(const BitVector *a, const BitVector *b, int length, int limit)
+{
+  int
     i,
     result = 0;
 
-  for(i = 0; i != bitVectorLength; i++)
-    result += BIT_COUNT(bitVector[i]);
+  for(i = 0; i + 8 <= length && result <= limit; i += 8)
+    result += sumLanesAvx2(popcountAvx2(_mm256_xor_si256(_mm256_loadu_si256((const __m256i*)(a + i)),
+                                                         _mm256_loadu_si256((const __m256i*)(b + i)))));
 
-  return result;
+  if(result > limit)
+    return result;
+
+  return result + xorBitCountPopcnt(a + i, b + i, length - i, limit - result);
+}
+
+
+__attribute__((target("avx2,popcnt")))
+static int xnorBitCountAvx2(const BitVector *a, const BitVector *b,
+                            const BitVector *maskA, const BitVector *maskB,
+                            int length, int limit)
+{
+  int
+    i,
+    result = 0;
+
+  for(i = 0; i + 8 <= length && result <= limit; i += 8)
+    {
+      __m256i
+        difference = _mm256_or_si256(_mm256_xor_si256(_mm256_loadu_si256((const __m256i*)(a + i)),
+                                                      _mm256_loadu_si256((const __m256i*)(b + i))),
+                                     _mm256_or_si256(_mm256_loadu_si256((const __m256i*)(maskA + i)),
+                                                     _mm256_loadu_si256((const __m256i*)(maskB + i))));
+
+      /* andnot with all ones inverts */
+      result += sumLanesAvx2(popcountAvx2(_mm256_andnot_si256(difference, _mm256_set1_epi8(-1))));
+    }
+
+  if(result > limit)
+    return result;
+
+  return result + xnorBitCountPopcnt(a + i, b + i, maskA + i, maskB + i, length - i, limit - result);
+}
+
+
+#if defined(__clang__) || __GNUC__ >= 8
+#define AVX512_KERNELS
+
+__attribute__((target("avx512f,avx512vpopcntdq,popcnt")))
+static int bitCountAvx512(const BitVector *a, int length)
+{
+  int
+    i;
+
+  __m512i
+    sum = _mm512_setzero_si512();
+
+  for(i = 0; i + 16 <= length; i += 16)
+    sum = _mm512_add_epi64(sum, _mm512_popcnt_epi64(_mm512_loadu_si512(a + i)));
+
+  return (int)_mm512_reduce_add_epi64(sum) + bitCountPopcnt(a + i, length - i);
+}
+
+
+__attribute__((target("avx512f,avx512vpopcntdq,popcnt")))
+static int xorBitCountAvx512(const BitVector *a, const BitVector *b, int length, int limit)
+{
+  int
+    i,
+    result = 0;
+
+  for(i = 0; i + 16 <= length && result <= limit; i += 16)
+    result += (int)_mm512_reduce_add_epi64(_mm512_popcnt_epi64(_mm512_xor_si512(_mm512_loadu_si512(a + i),
+                                                                                 _mm512_loadu_si512(b + i))));
+
+  if(result > limit)
+    return result;
+
+  return result + xorBitCountPopcnt(a + i, b + i, length - i, limit - result);
+}
+
+
+__attribute__((target("avx512f,avx512vpopcntdq,popcnt")))
+static int xnorBitCountAvx512(const BitVector *a, const BitVector *b,
+                              const BitVector *maskA, const BitVector *maskB,
+                              int length, int limit)
+{
+  int
+    i,
+    result = 0;
+
+  for(i = 0; i + 16 <= length && result <= limit; i += 16)
+    {
+      /* 0x01 is the truth table of ~(x | y | z) */
+      __m512i
+        difference = _mm512_xor_si512(_mm512_loadu_si512(a + i), _mm512_loadu_si512(b + i)),
+        same = _mm512_ternarylogic_epi64(difference, _mm512_loadu_si512(maskA + i),
+                                         _mm512_loadu_si512(maskB + i), 0x01);
+
+      result += (int)_mm512_reduce_add_epi64(_mm512_popcnt_epi64(same));
+    }
+
+  if(result > limit)
+    return result;
+
+  return result + xnorBitCountPopcnt(a + i, b + i, maskA + i, maskB + i, length - i, limit - result);
+}
+#endif
+#endif
+
+
+void initializeBitVectorKernels(void)
+{
+#ifdef X86_KERNELS
+  __builtin_cpu_init();
+
+  hasPopcnt = __builtin_cpu_supports("popcnt") ? TRUE : FALSE;
+
+  /* the wide variants have no fused counts */
+  if(hasPopcnt)
+    differenceBitCountsCpu = differenceBitCountsPopcnt;
+
+#ifdef AVX512_KERNELS
+  if(__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512vpopcntdq"))
+    {
+      bitCountKernel = bitCountAvx512;
+      xorBitCountCpu = xorBitCountAvx512;
+      xnorBitCountCpu = xnorBitCountAvx512;
+    }
+  else
+#endif
+  if(__builtin_cpu_supports("avx2") && hasPopcnt)
+    {
+      bitCountKernel = bitCountAvx2;
+      xorBitCountCpu = xorBitCountAvx2;
+      xnorBitCountCpu = xnorBitCountAvx2;
+    }
+  else if(hasPopcnt)
+    {
+      bitCountKernel = bitCountPopcnt;
+      xorBitCountCpu = xorBitCountPopcnt;
+      xnorBitCountCpu = xnorBitCountPopcnt;
+    }
+#endif
+
+  selectBitVectorKernels(0);
+}
+
+
+/* the number of words of the taxon vectors of mxtips taxa, rounded up
+   to a width with specialized kernels */
+int getKernelBitVectorLength(int mxtips)
+{
+  int
+    length = GET_BITVECTOR_LENGTH(mxtips);
+
+  if(length <= 2)
+    return 2;
+  if(length <= 4)
+    return 4;
+  if(length <= 8)
+    return 8;
+  if(length <= 16)
+    return 16;
+
+  return length;
+}
+
+
+#ifdef X86_KERNELS
+#define SELECT_FIXED_WIDTH_KERNELS(WORDS)                               \
+  case WORDS:                                                           \
+    xorBitCountKernel = hasPopcnt ? xorBitCount##WORDS##Popcnt : xorBitCount##WORDS##Portable; \
+    xnorBitCountKernel = hasPopcnt ? xnorBitCount##WORDS##Popcnt : xnorBitCount##WORDS##Portable; \
+    differenceBitCountsKernel = hasPopcnt ? differenceBitCounts##WORDS##Popcnt : differenceBitCounts##WORDS##Portable; \
+    compatibleKernel = hasPopcnt ? compatibleBitVectors##WORDS##Popcnt : compatibleBitVectors##WORDS##Portable; \
+    complementKernel = hasPopcnt ? complementBitVector##WORDS##Popcnt : complementBitVector##WORDS##Portable; \
+    break
+#else
+#define SELECT_FIXED_WIDTH_KERNELS(WORDS)                               \
+  case WORDS:                                                           \
+    xorBitCountKernel = xorBitCount##WORDS##Portable;                   \
+    xnorBitCountKernel = xnorBitCount##WORDS##Portable;                 \
+    differenceBitCountsKernel = differenceBitCounts##WORDS##Portable;   \
+    compatibleKernel = compatibleBitVectors##WORDS##Portable;           \
+    complementKernel = complementBitVector##WORDS##Portable;            \
+    break
+#endif
+
+/* xorBitCount, xnorBitCount, differenceBitCounts, compatibleBitVectors
+   and complementBitVector then only take vectors of bitVectorLength words
+   (any length, if it is 0) */
+void selectBitVectorKernels(int bitVectorLength)
+{
+  switch(bitVectorLength)
+    {
+      SELECT_FIXED_WIDTH_KERNELS(2);
+      SELECT_FIXED_WIDTH_KERNELS(4);
+      SELECT_FIXED_WIDTH_KERNELS(8);
+      SELECT_FIXED_WIDTH_KERNELS(16);
+    default:
+      xorBitCountKernel = xorBitCountCpu;
+      xnorBitCountKernel = xnorBitCountCpu;
+      differenceBitCountsKernel = differenceBitCountsCpu;
+      compatibleKernel = compatibleBitVectorsGeneric;
+      complementKernel = complementBitVectorGeneric;
+    }
+}
+
+
+BitVector genericBitCount(BitVector* bitVector, int bitVectorLength)
+{
+  return bitCountKernel(bitVector, bitVectorLength);
+}
+
+
+/* number of bits set in a ^ b */
+int xorBitCount(const BitVector *a, const BitVector *b, int bitVectorLength, int limit)
+{
+  return xorBitCountKernel(a, b, bitVectorLength, limit);
+}
+
+
+/* number of bits set in ~((a ^ b) | maskA | maskB) */
+int xnorBitCount(const BitVector *a, const BitVector *b,
+                 const BitVector *maskA, const BitVector *maskB,
+                 int bitVectorLength, int limit)
+{
+  return xnorBitCountKernel(a, b, maskA, maskB, bitVectorLength, limit);
+}
+
+
+/* both counts at once, the pass may stop once both exceed limit */
+void differenceBitCounts(const BitVector *a, const BitVector *b,
+                         const BitVector *maskA, const BitVector *maskB,
+                         int bitVectorLength, int limit,
+                         int *xorCount, int *xnorCount)
+{
+  differenceBitCountsKernel(a, b, maskA, maskB, bitVectorLength, limit, xorCount, xnorCount);
+}
+
+
+/* a signature has a byte per 64-bit lane of a taxon vector (the number
+   of bits set in the lane) and is padded with zeros to a multiple of
+   8 bytes. The bits of two vectors differ in at least as many
+   positions, as their signatures differ in sum. */
+int getSignatureLength(int bitVectorLength)
+{
+  int
+    lanes = (bitVectorLength + 1) / 2;
+
+  return (lanes + 7) & ~7;
+}
+
+
+/* the signature of ~(a | maskA | maskB) (or of a, if there are no
+   masks) */
+void computeSignature(const BitVector *a, const BitVector *maskA, const BitVector *maskB,
+                      uint8_t *signature, int bitVectorLength)
+{
+  int
+    i;
+
+  memset(signature, 0, getSignatureLength(bitVectorLength));
+
+  FOR_0_LIMIT(i, bitVectorLength)
+    {
+      BitVector
+        word = maskA ? ~(a[i] | maskA[i] | maskB[i]) : a[i];
+
+      signature[i / 2] += BIT_COUNT(word);
+    }
 }
 
 
-static int iterated_bitcount(BitVector n)
+/* the sum of the absolute differences of the bytes */
+int signatureDistance(const uint8_t *a, const uint8_t *b, int signatureLength)
 {
-    int
-      count = 0;
+  int
+    i,
+    result = 0;
 
-    while(n)
-      {
-        count += n & 0x1u;
-        n >>= 1;
-      }
+#if defined(X86_KERNELS) && defined(__SSE2__)
+  for(i = 0; i < signatureLength; i += 8)
+    result += _mm_cvtsi128_si32(_mm_sad_epu8(_mm_loadl_epi64((const __m128i*)(a + i)),
+                                             _mm_loadl_epi64((const __m128i*)(b + i))));
+#else
+  FOR_0_LIMIT(i, signatureLength)
+    result += a[i] > b[i] ? a[i] - b[i] : b[i] - a[i];
+#endif
 
-    return count;
+  return result;
 }
 
-void compute_bits_in_16bits(void)
+
+/* sums up the weights of the bits that are set. Without weights,
+   this is the number of bits set. */
+int weightedBitCount(BitVector *bitVector, int bitVectorLength, const int *weights)
 {
-    BitVector i;
+  int
+    i,
+    result = 0;
+
+  if(NOT weights)
+    return genericBitCount(bitVector, bitVectorLength);
 
-    for (i = 0; i < (0x1u<<16); i++)
-        bits_in_16bits[i] = iterated_bitcount(i);
+  FOR_0_LIMIT(i, bitVectorLength)
+    {
+      BitVector
+        word = bitVector[i];
 
-    return ;
+      while(word)
+        {
+          result += weights[i * MASK_LENGTH + __builtin_ctz(word)];
+          word &= word - 1;
+        }
+    }
+
+  return result;
 }
 
-BitVector precomputed16_bitcount (BitVector n)
+
+/* the 64-bit Zobrist key of a taxon (splitmix64 of its bit index).
+   The fingerprint of a split is the XOR of the keys of its taxa, thus
+   it can be updated taxon by taxon and the fingerprint of the
+   complement is the XOR with the fingerprint of all taxa. */
+uint64_t taxonKey(int taxon)
 {
-  /* works only for 32-bit int*/
-    return bits_in_16bits[n         & 0xffffu]
-        +  bits_in_16bits[(n >> 16) & 0xffffu];
+  uint64_t
+    z = (uint64_t)(taxon + 1) * 0x9E3779B97F4A7C15ULL;
+
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+
+  return z ^ (z >> 31);
 }
 
 
+uint64_t bitVectorFingerprint(BitVector *bitVector, int bitVectorLength)
+{
+  int
+    i;
+
+  uint64_t
+    result = 0;
+
+  FOR_0_LIMIT(i, bitVectorLength)
+    {
+      BitVector
+        word = bitVector[i];
+
+      while(word)
+        {
+          result ^= taxonKey(i * MASK_LENGTH + __builtin_ctz(word));
+          word &= word - 1;
+        }
+    }
+
+  return result;
+}
+
 
 BitVector *copyBitVector(BitVector *bitVector, int bitVectorLength)
 {
@@ -133,4 +716,44 @@ BitVector *copyBitVector(BitVector *bitVector, int bitVectorLength)
 }
 
 
+/* (re)allocates size bytes of rows that start at a multiple of
+   ROW_ALIGNMENT. *block is the allocation the rows are in (NULL, if
+   there is none yet) and is updated; the first usedSize bytes of the
+   rows are kept. Returns the new start of the rows. */
+BitVector *reallocAlignedRows(void **block, BitVector *rows, size_t usedSize, size_t size)
+{
+  size_t
+    oldOffset = *block ? (size_t)((char*)rows - (char*)*block) : 0,
+    newOffset;
+
+  char
+    *result = realloc(*block, size + ROW_ALIGNMENT);
+
+  assert(usedSize <= size && oldOffset < ROW_ALIGNMENT);
+
+  /* realloc keeps the offset of the rows, but not their alignment */
+  newOffset = (ROW_ALIGNMENT - (uintptr_t)result % ROW_ALIGNMENT) % ROW_ALIGNMENT;
+  if(newOffset != oldOffset && usedSize > 0)
+    memmove(result + newOffset, result + oldOffset, usedSize);
+
+  *block = result;
+
+  return (BitVector*)(result + newOffset);
+}
+
+
+/* TRUE, if the splits a and b (restricted to the taxa in neither
+   mask) are compatible */
+boolean compatibleBitVectors(const BitVector *a, const BitVector *b,
+                             const BitVector *maskA, const BitVector *maskB,
+                             int bitVectorLength)
+{
+  return compatibleKernel(a, b, maskA, maskB, bitVectorLength);
+}
+
 
+/* a = ~(a | maskA | maskB) */
+void complementBitVector(BitVector *a, const BitVector *maskA, const BitVector *maskB, int bitVectorLength)
+{
+  complementKernel(a, maskA, maskB, bitVectorLength);
+}
@@ -42,26 +42,40 @@
 
 typedef uint32_t BitVector;
 
-#define BIT_COUNT(x) precomputed16_bitcount(x)
+#define BIT_COUNT(x) __builtin_popcount(x)
 #define NUMBER_BITS_IN_COMPLEMENT(bipartition) (mxtips - dropRound - bipartition->numberOfBitsSet)
 #define GET_BITVECTOR_LENGTH(x) (((x) % MASK_LENGTH) ? ((x) / MASK_LENGTH + 1) : ((x) / MASK_LENGTH))
-#define FLIP_NTH_BIT(bitVector,n) (bitVector[(n) / MASK_LENGTH] |= mask32[ (n) % MASK_LENGTH ])
-#define UNFLIP_NTH_BIT(bitVector,n) (bitVector[(n) / MASK_LENGTH] &= ~mask32[ (n) % MASK_LENGTH ])
-#define NTH_BIT_IS_SET(bitVector,n) (bitVector[(n) / MASK_LENGTH] & mask32[(n) % MASK_LENGTH])
-#define NTH_BIT_IS_SET_IN_INT(integer,n) (integer & mask32[n])
+#define NTH_BIT(n) ((BitVector)1 << ((n) % MASK_LENGTH))
+#define FLIP_NTH_BIT(bitVector,n) (bitVector[(n) / MASK_LENGTH] |= NTH_BIT(n))
+#define UNFLIP_NTH_BIT(bitVector,n) (bitVector[(n) / MASK_LENGTH] &= ~NTH_BIT(n))
+#define NTH_BIT_IS_SET(bitVector,n) (bitVector[(n) / MASK_LENGTH] & NTH_BIT(n))
+#define NTH_BIT_IS_SET_IN_INT(integer,n) (integer & NTH_BIT(n))
 #define MASK_LENGTH 32
+#define ROW_ALIGNMENT 64        /* rows of bit vectors start at a cache line */
 
-extern char bits_in_16bits[];
 extern BitVector *mask32;
 
 void initializeMask(void);
 void destroyMask(void);
+void initializeBitVectorKernels(void);
+int getKernelBitVectorLength(int mxtips);
+void selectBitVectorKernels(int bitVectorLength);
 BitVector genericBitCount(BitVector* bitVector, int bitVectorLength);
-BitVector precomputed16_bitcount (BitVector n);
-void compute_bits_in_16bits(void);
+int xorBitCount(const BitVector *a, const BitVector *b, int bitVectorLength, int limit);
+int xnorBitCount(const BitVector *a, const BitVector *b, const BitVector *maskA, const BitVector *maskB, int bitVectorLength, int limit);
+void differenceBitCounts(const BitVector *a, const BitVector *b, const BitVector *maskA, const BitVector *maskB, int bitVectorLength, int limit, int *xorCount, int *xnorCount);
+int getSignatureLength(int bitVectorLength);
+void computeSignature(const BitVector *a, const BitVector *maskA, const BitVector *maskB, uint8_t *signature, int bitVectorLength);
+int signatureDistance(const uint8_t *a, const uint8_t *b, int signatureLength);
+boolean compatibleBitVectors(const BitVector *a, const BitVector *b, const BitVector *maskA, const BitVector *maskB, int bitVectorLength);
+void complementBitVector(BitVector *a, const BitVector *maskA, const BitVector *maskB, int bitVectorLength);
+int weightedBitCount(BitVector *bitVector, int bitVectorLength, const int *weights);
+uint64_t taxonKey(int taxon);
+uint64_t bitVectorFingerprint(BitVector *bitVector, int bitVectorLength);
 void printBitVector(BitVector *bv, int length);
 void freeBitVectors(BitVector **v, int n);
 BitVector *copyBitVector(BitVector *bitVector, int bitVectorLength);
+BitVector *reallocAlignedRows(void **block, BitVector *rows, size_t usedSize, size_t size);
 void printBitVector(BitVector *bv, int length);
 
 #endif
@@ -0,0 +1,226 @@
+/*  RogueNaRok is an algorithm for the identification of rogue taxa in a set of phylogenetic trees. 
+ *
+ *  Moreover, the program collection comes with efficient implementations of 
+ *   * the unrooted leaf stability by Thorley and Wilkinson
+ *   * the taxonomic instability index by Maddinson and Maddison
+ *   * a maximum agreement subtree implementation (MAST) for unrooted trees 
+ *   * a tool for pruning taxa from a tree collection. 
+ * 
+ *  Copyright October 2011 by Andre J. Aberer
+ * 
+ *  Tree I/O and parallel framework are derived from RAxML by Alexandros Stamatakis.
+ *
+ *  This program is free software; you may redistribute it and/or
+ *  modify its under the terms of the GNU General Public License as
+ *  published by the Free Software Foundation; either version 2 of the
+ *  License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  For any other inquiries send an Email to Andre J. Aberer
+ *  andre.aberer at googlemail.com
+ * 
+ *  When publishing work that is based on the results from RogueNaRok, please cite:
+ *  Andre J. Aberer, Denis Krompaß, Alexandros Stamatakis. RogueNaRok: an Efficient and Exact Algorithm for Rogue Taxon Identification. (unpublished) 2011. 
+ * 
+ */
+
+#include "CandidateIndex.h"
+
+typedef struct
+{
+  int length;
+  int capacity;
+  int *positions;
+} PositionList;
+
+
+static int sortPositions(const void *a, const void *b)
+{
+  return *(const int*)a - *(const int*)b;
+}
+
+
+/* returns the slot of the bucket or the empty slot where it belongs */
+static uint32_t findBucket(CandidateIndex *index, uint64_t key)
+{
+  uint32_t
+    position = (uint32_t)key & index->tableMask;
+
+  while(index->bucketLength[position] && index->keys[position] != key)
+    position = (position + 1) & index->tableMask;
+
+  return position;
+}
+
+
+/* indexes the bipartitions of the profile (sorted by number of bits,
+   NULL only at the end) for neighborhoods of up to maxDistance of the
+   taxa in neglectThose, that have not been dropped */
+CandidateIndex *createCandidateIndex(Array *bipartitionProfile, int maxDistance,
+                                     const BitVector *neglectThose, const BitVector *droppedTaxa, int mxtips)
+{
+  CandidateIndex
+    *index = CALLOC(1, sizeof(CandidateIndex));
+
+  int
+    i,
+    numberOfElems = 0,
+    start = 0;
+
+  uint32_t
+    slot,
+    tableSize = 64;
+
+  while(numberOfElems < (int)bipartitionProfile->length
+        && GET_PROFILE_ELEM(bipartitionProfile, numberOfElems))
+    numberOfElems++;
+
+  while(tableSize < 2 * (uint32_t)numberOfElems)
+    tableSize *= 2;
+
+  index->tableMask = tableSize - 1;
+  index->keys = CALLOC(tableSize, sizeof(uint64_t));
+  index->bucketStart = CALLOC(tableSize, sizeof(int));
+  index->bucketLength = CALLOC(tableSize, sizeof(int));
+  index->positions = CALLOC(MAX(numberOfElems, 1), sizeof(int));
+
+  /* count the bipartitions per fingerprint, then lay out the buckets
+     and fill them from the back */
+  FOR_0_LIMIT(i, numberOfElems)
+    {
+      uint64_t
+        key = GET_PROFILE_ELEM(bipartitionProfile, i)->fingerprint;
+
+      slot = findBucket(index, key);
+      index->keys[slot] = key;
+      index->bucketLength[slot]++;
+    }
+
+  FOR_0_LIMIT(slot, tableSize)
+    {
+      start += index->bucketLength[slot];
+      index->bucketStart[slot] = start;
+    }
+
+  for(i = numberOfElems - 1; i >= 0; --i)
+    {
+      slot = findBucket(index, GET_PROFILE_ELEM(bipartitionProfile, i)->fingerprint);
+      index->positions[--index->bucketStart[slot]] = i;
+    }
+
+  index->maxDistance = maxDistance;
+  index->taxonKeys = CALLOC(mxtips, sizeof(uint64_t));
+  FOR_0_LIMIT(i, mxtips)
+    if(NTH_BIT_IS_SET(neglectThose, i) && NOT NTH_BIT_IS_SET(droppedTaxa, i))
+      index->taxonKeys[index->numberOfTaxa++] = taxonKey(i);
+
+  index->numberOfLookups = getNeighborhoodSize(index->numberOfTaxa, maxDistance);
+
+  return index;
+}
+
+
+/* the number of sets of 1 to maxDistance of numberOfTaxa taxa */
+double getNeighborhoodSize(int numberOfTaxa, int maxDistance)
+{
+  int
+    i;
+
+  double
+    subsets = 1,
+    result = 0;
+
+  FOR_0_LIMIT(i, MIN(maxDistance, numberOfTaxa))
+    {
+      subsets = subsets * (numberOfTaxa - i) / (i + 1);
+      result += subsets;
+    }
+
+  return result;
+}
+
+
+void freeCandidateIndex(CandidateIndex *index)
+{
+  free(index->keys);
+  free(index->bucketStart);
+  free(index->bucketLength);
+  free(index->positions);
+  free(index->taxonKeys);
+  free(index);
+}
+
+
+static void addBucket(CandidateIndex *index, uint64_t fingerprint, PositionList *list)
+{
+  uint32_t
+    slot = findBucket(index, fingerprint);
+
+  if(NOT index->bucketLength[slot])
+    return;
+
+  if(list->length + index->bucketLength[slot] > list->capacity)
+    {
+      list->capacity = 2 * (list->length + index->bucketLength[slot]);
+      list->positions = realloc(list->positions, list->capacity * sizeof(int));
+    }
+
+  memcpy(list->positions + list->length, index->positions + index->bucketStart[slot],
+         index->bucketLength[slot] * sizeof(int));
+  list->length += index->bucketLength[slot];
+}
+
+
+/* adds the bipartitions, whose fingerprint differs from fingerprint by
+   the keys of 1 to depth taxa (each from firstTaxon on) */
+static void addNeighborhood(CandidateIndex *index, uint64_t fingerprint, int firstTaxon, int depth, PositionList *list)
+{
+  int
+    i;
+
+  FOR_N_LIMIT(i, firstTaxon, index->numberOfTaxa)
+    {
+      uint64_t
+        neighbor = fingerprint ^ index->taxonKeys[i];
+
+      addBucket(index, neighbor, list);
+
+      if(depth > 1)
+        addNeighborhood(index, neighbor, i + 1, depth - 1, list);
+    }
+}
+
+
+/* the positions (ascending, without duplicates) of all bipartitions,
+   whose fingerprint is in the neighborhood of fingerprint (or,
+   withComplement, of complementFingerprint). This includes all
+   bipartitions, that differ in 1 to maxDistance taxa that may be
+   dropped. The number of positions is returned, result is allocated. */
+int getCandidates(CandidateIndex *index, uint64_t fingerprint, uint64_t complementFingerprint,
+                  boolean withComplement, int **result)
+{
+  int
+    i,
+    numberOfCandidates = 0;
+
+  PositionList
+    list = {0, 0, NULL};
+
+  addNeighborhood(index, fingerprint, 0, index->maxDistance, &list);
+  if(withComplement)
+    addNeighborhood(index, complementFingerprint, 0, index->maxDistance, &list);
+
+  if(list.length > 0)
+    qsort(list.positions, list.length, sizeof(int), sortPositions);
+
+  FOR_0_LIMIT(i, list.length)
+    if(i == 0 || list.positions[i] != list.positions[i-1])
+      list.positions[numberOfCandidates++] = list.positions[i];
+
+  *result = list.positions;
+  return numberOfCandidates;
+}
@@ -0,0 +1,65 @@
+/*  RogueNaRok is an algorithm for the identification of rogue taxa in a set of phylogenetic trees. 
+ *
+ *  Moreover, the program collection comes with efficient implementations of 
+ *   * the unrooted leaf stability by Thorley and Wilkinson
+ *   * the taxonomic instability index by Maddinson and Maddison
+ *   * a maximum agreement subtree implementation (MAST) for unrooted trees 
+ *   * a tool for pruning taxa from a tree collection. 
+ * 
+ *  Copyright October 2011 by Andre J. Aberer
+ * 
+ *  Tree I/O and parallel framework are derived from RAxML by Alexandros Stamatakis.
+ *
+ *  This program is free software; you may redistribute it and/or
+ *  modify its under the terms of the GNU General Public License as
+ *  published by the Free Software Foundation; either version 2 of the
+ *  License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  For any other inquiries send an Email to Andre J. Aberer
+ *  andre.aberer at googlemail.com
+ * 
+ *  When publishing work that is based on the results from RogueNaRok, please cite:
+ *  Andre J. Aberer, Denis Krompaß, Alexandros Stamatakis. RogueNaRok: an Efficient and Exact Algorithm for Rogue Taxon Identification. (unpublished) 2011. 
+ * 
+ */
+
+
+#ifndef CANDIDATEINDEX_H
+#define CANDIDATEINDEX_H
+
+#include "common.h"
+#include "Array.h"
+#include "BitVector.h"
+#include "ProfileElem.h"
+
+/* index of the bipartitions of a profile by their fingerprints. The
+   fingerprints of two bipartitions that differ in the taxa of a set S
+   differ by the XOR of the keys of S, s.t. the bipartitions within k
+   taxa are found by looking up the fingerprints of the
+   deletion/insertion neighborhood of a bipartition (all sets of up
+   to k taxa that may be dropped). */
+typedef struct
+{
+  uint32_t tableMask;
+  uint64_t *keys;
+  int *bucketStart;
+  int *bucketLength;            /* 0 for empty slots */
+  int *positions;               /* ascending within a bucket */
+
+  int maxDistance;
+  int numberOfTaxa;
+  uint64_t *taxonKeys;          /* of the taxa that may be dropped */
+  double numberOfLookups;       /* per neighborhood */
+} CandidateIndex;
+
+CandidateIndex *createCandidateIndex(Array *bipartitionProfile, int maxDistance, const BitVector *neglectThose, const BitVector *droppedTaxa, int mxtips);
+void freeCandidateIndex(CandidateIndex *index);
+double getNeighborhoodSize(int numberOfTaxa, int maxDistance);
+int getCandidates(CandidateIndex *index, uint64_t fingerprint, uint64_t complementFingerprint, boolean withComplement, int **result);
+
+#endif
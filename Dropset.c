@@ -38,6 +38,24 @@ extern int mxtips,
 extern BitVector *droppedTaxa,
   *neglectThose,
   *paddingBits;
+extern uint64_t remainingFingerprint;
+
+/* dropsets are cut from an arena, a released one is kept for reuse in
+   a list. The arena frees all of them at the end of the run. */
+typedef union _pooledDropset
+{
+  Dropset dropset;
+  union _pooledDropset *next;
+} PooledDropset;
+
+static Arena *dropsetArena = NULL;
+static PooledDropset *freeDropsets = NULL;
+
+/* taxa by their Zobrist key (open addressing), s.t. a fingerprint
+   difference can be identified as a single taxon */
+static uint64_t *keyTable = NULL;
+static int *taxonTable = NULL;
+static uint32_t keyTableMask = 0;
 
 
 void initializeRandForTaxa(int mxtips)
@@ -49,200 +67,293 @@ void initializeRandForTaxa(int mxtips)
 }
 
 
-/* is ONLY done for adding OWN elements */
-void addEventToDropsetPrime(Dropset *dropset, int a, int b)
+void initializeTaxonKeys(int mxtips)
 {
-  List
-    *lIter;
+  int i;
+  uint32_t tableSize = 64;
+
+  while(tableSize < 2 * (uint32_t)mxtips)
+    tableSize *= 2;
 
-  lIter = dropset->ownPrimeE;
-  while(lIter)
+  keyTableMask = tableSize - 1;
+  keyTable = CALLOC(tableSize, sizeof(uint64_t));
+  taxonTable = CALLOC(tableSize, sizeof(int));
+
+  FOR_0_LIMIT(i, mxtips)
     {
-      List *next = lIter->next;
-      MergingEvent *me = lIter->value;
+      uint64_t key = taxonKey(i);
+      uint32_t position = (uint32_t)key & keyTableMask;
 
-      assert(NOT me->isComplex);
+      while(taxonTable[position])
+        position = (position + 1) & keyTableMask;
 
-      if( me->mergingBipartitions.pair[0] == a
-	  || me->mergingBipartitions.pair[1] == b
-	  || me->mergingBipartitions.pair[1] == a
-	  || me->mergingBipartitions.pair[0] == b)
-	{
-	  assert( (me->mergingBipartitions.pair[0] == a)
-	  	  + (me->mergingBipartitions.pair[1] == b)
-	  	  + (me->mergingBipartitions.pair[0] == b)
-	  	  + (me->mergingBipartitions.pair[1] == a)
-	  	  == 2);
-	  return;
-	}
-      lIter = next;
+      keyTable[position] = key;
+      taxonTable[position] = i + 1;
     }
+}
 
-  MergingEvent
-    *result = CALLOC(1,sizeof(MergingEvent));
-  result->mergingBipartitions.pair[0] = b;
-  result->mergingBipartitions.pair[1] = a;
 
-  APPEND(result, dropset->ownPrimeE);
+void freeTaxonKeys(void)
+{
+  free(keyTable);
+  free(taxonTable);
+  keyTable = NULL;
+  taxonTable = NULL;
 }
 
 
-List *addEventToDropsetCombining(List *complexEvents, MergingBipartitions primeEvent)
+/* returns the taxon with this key or -1 */
+static int findTaxonByKey(uint64_t key)
 {
-  int
-    a = primeEvent.pair[0],
-    b = primeEvent.pair[1];
+  uint32_t position = (uint32_t)key & keyTableMask;
 
-  List
-    *firstElem = NULL,
-    *secondElem = NULL;
+  for(; taxonTable[position]; position = (position + 1) & keyTableMask)
+    if(keyTable[position] == key)
+      return taxonTable[position] - 1;
 
-  /* find list elems that already contain merging events  */
-  List *iter ;
+  return -1;
+}
 
-  iter = complexEvents;
-  FOR_LIST(iter)
-  {
-    int res = isInIndexListSpecial(a,b,((MergingEvent*)iter->value)->mergingBipartitions.many);
-    if(res)
-      {
-	if(NOT firstElem)
-	  firstElem = iter;
-	else if(NOT secondElem)
-	  secondElem = iter;
-	else break;
-      }
-  }
+
+static uint32_t *findPrimeBip(Dropset *dropset, int bip)
+{
+  uint32_t
+    position = ((uint32_t)bip * 2654435761U) & dropset->primeBipsMask;
+
+  while(dropset->primeBips[position] && dropset->primeBips[position] != (uint32_t)bip + 1)
+    position = (position + 1) & dropset->primeBipsMask;
+
+  return dropset->primeBips + position;
+}
 
 
-  if(firstElem && secondElem)
+static void addPrimeBip(Dropset *dropset, int bip)
+{
+  uint32_t
+    *slot;
+
+  /* keep the load factor below 1/2 */
+  if(2 * (dropset->numberOfPrimeBips + 1) > dropset->primeBipsMask + 1)
     {
-      /* merge bips into first elem */
-      IndexList
-	*il = ((MergingEvent*)secondElem->value)->mergingBipartitions.many,
-	*persistentIndexList = ((MergingEvent*)firstElem->value)->mergingBipartitions.many;
-      FOR_LIST(il)
-	persistentIndexList = appendToIndexListIfNotThere(il->index, persistentIndexList);
-      ((MergingEvent*)firstElem->value)->mergingBipartitions.many = persistentIndexList;
-      freeIndexList(((MergingEvent*)secondElem->value)->mergingBipartitions.many);
-      free((MergingEvent*)secondElem->value);
-
-      /* remove second element */
-      if(complexEvents == secondElem)
-	complexEvents = secondElem->next;
-      else
-	{
-	  iter = complexEvents;
-	  FOR_LIST(iter)
-	  {
-	    if(iter->next == secondElem)
-	      {
-		iter->next = iter->next->next;
-		break;
-	      }
-	  }
-	}
-      free(secondElem);
+      uint32_t
+        i,
+        *oldBips = dropset->primeBips,
+        oldSize = dropset->primeBipsMask + 1;
+
+      dropset->primeBipsMask = 2 * oldSize - 1;
+      dropset->primeBips = CALLOC(2 * oldSize, sizeof(uint32_t));
+
+      FOR_0_LIMIT(i, oldSize)
+        if(oldBips[i])
+          *findPrimeBip(dropset, oldBips[i] - 1) = oldBips[i];
+
+      free(oldBips);
     }
-  else if(firstElem)
+
+  slot = findPrimeBip(dropset, bip);
+  if( NOT *slot)
     {
-      assert( NOT secondElem);
-      MergingEvent *me = firstElem->value;
-      me->mergingBipartitions.many = appendToIndexListIfNotThere(a,me->mergingBipartitions.many);
-      me->mergingBipartitions.many = appendToIndexListIfNotThere(b,me->mergingBipartitions.many);
+      *slot = bip + 1;
+      dropset->numberOfPrimeBips++;
     }
-  else
+}
+
+
+/* to be called, whenever events are removed from ownPrimeE (or added
+   without addEventToDropsetPrime) */
+void forgetPrimeBips(Dropset *dropset)
+{
+  free(dropset->primeBips);
+  dropset->primeBips = NULL;
+  dropset->primeBipsMask = 0;
+  dropset->numberOfPrimeBips = 0;
+}
+
+
+/* makes room for at least needed elements in a vector of the given
+   capacity (that grows by doubling) */
+static void *reserveVector(void *vector, int *capacity, int needed, size_t elemSize)
+{
+  if(needed > *capacity)
     {
-      MergingEvent
-	*me = CALLOC(1,sizeof(MergingEvent));
-      me->isComplex = TRUE;
-
-      me->mergingBipartitions.many = NULL;
-      APPEND_INT(a,me->mergingBipartitions.many);
-      APPEND_INT(b,me->mergingBipartitions.many);
-      APPEND(me, complexEvents);
+      int
+        newCapacity = MAX(*capacity, 4);
+
+      while(newCapacity < needed)
+        newCapacity *= 2;
+
+      vector = realloc(vector, newCapacity * elemSize);
+      assert(vector);
+      *capacity = newCapacity;
     }
 
-  return complexEvents;
+  return vector;
 }
 
 
-void freeDropsetDeepInHash(void *value)
+static MergingEvent *appendOwnEvent(Dropset *dropset)
 {
-  freeDropsetDeep(value, TRUE);
+  MergingEvent
+    *result;
+
+  dropset->ownPrimeE = reserveVector(dropset->ownPrimeE, &dropset->ownPrimeECapacity,
+                                     dropset->numberOfOwnPrimeE + 1, sizeof(MergingEvent));
+  result = dropset->ownPrimeE + dropset->numberOfOwnPrimeE++;
+  memset(result, 0, sizeof(MergingEvent));
+
+  return result;
 }
 
 
-void freeDropsetDeep(void *value, boolean extended)
+/* is ONLY done for adding OWN elements. A bipartition takes part in
+   at most one event of a dropset */
+void addEventToDropsetPrime(Dropset *dropset, int a, int b)
 {
-  Dropset
-    *dropset = (Dropset*) value;
-  List
-    *iter = NULL;
+  MergingEvent
+    *result;
 
-  if(dropset->taxaToDrop)
-    freeIndexList(dropset->taxaToDrop);
+  int
+    i;
 
-  /* free combined events */
-  if(extended && dropset->complexEvents)
+  if( NOT dropset->primeBips)
     {
-      iter = dropset->complexEvents;
-      while(iter)
-	{
-	  List *next = iter->next;
-	  MergingEvent *me = iter->value;
-	  freeIndexList(me->mergingBipartitions.many);
-	  free(me);
-	  iter = next;
-	}
-      freeListFlat(dropset->complexEvents);
+      dropset->primeBips = CALLOC(4, sizeof(uint32_t));
+      dropset->primeBipsMask = 3;
+
+      FOR_0_LIMIT(i, dropset->numberOfOwnPrimeE)
+        {
+          MergingEvent *me = dropset->ownPrimeE + i;
+          assert(NOT me->isComplex);
+          addPrimeBip(dropset, me->mergingBipartitions.pair[0]);
+          addPrimeBip(dropset, me->mergingBipartitions.pair[1]);
+        }
     }
 
-  if(extended && dropset->acquiredPrimeE)
-    freeListFlat(dropset->acquiredPrimeE);
-
-  /* ownPrimeE */
-  iter = dropset->ownPrimeE;
-  while(iter)
+  if(*findPrimeBip(dropset, a) || *findPrimeBip(dropset, b))
     {
-      List *next = iter->next;
-      free((MergingEvent*)iter->value);
-      iter = next;
+      assert(*findPrimeBip(dropset, a) && *findPrimeBip(dropset, b));
+      return;
     }
-  freeListFlat(dropset->ownPrimeE);
 
-  free(dropset);
+  result = appendOwnEvent(dropset);
+  result->mergingBipartitions.pair[0] = b;
+  result->mergingBipartitions.pair[1] = a;
+
+  addPrimeBip(dropset, a);
+  addPrimeBip(dropset, b);
 }
 
 
-void freeDropsetDeepInEnd(void *value)
+/* me is an own event of the dropset or of one of its subsets */
+void addAcquiredEvent(Dropset *dropset, MergingEvent *me)
 {
-  Dropset
-    *dropset = (Dropset*) value;
-  List
-    *iter = NULL;
+  dropset->acquiredPrimeE = reserveVector(dropset->acquiredPrimeE, &dropset->acquiredPrimeECapacity,
+                                          dropset->numberOfAcquiredPrimeE + 1, sizeof(MergingEvent*));
+  dropset->acquiredPrimeE[dropset->numberOfAcquiredPrimeE++] = me;
+}
+
+
+/* the bipartitions of the component are copied */
+void addComplexEvent(Dropset *dropset, IndexList *component)
+{
+  MergingEvent
+    *me;
+
+  IndexList
+    *iter = component;
+
+  int
+    length = lengthIndexList(component);
+
+  dropset->complexEvents = reserveVector(dropset->complexEvents, &dropset->complexEventsCapacity,
+                                         dropset->numberOfComplexEvents + 1, sizeof(MergingEvent));
+  dropset->complexBips = reserveVector(dropset->complexBips, &dropset->complexBipsCapacity,
+                                       dropset->numberOfComplexBips + length, sizeof(int));
+
+  me = dropset->complexEvents + dropset->numberOfComplexEvents++;
+  memset(me, 0, sizeof(MergingEvent));
+  me->isComplex = TRUE;
+  me->mergingBipartitions.many.offset = dropset->numberOfComplexBips;
+  me->mergingBipartitions.many.length = length;
+
+  FOR_LIST(iter)
+    dropset->complexBips[dropset->numberOfComplexBips++] = iter->index;
+}
+
+
+/* the acquired and complex events are recombined in every round, the
+   vectors are kept */
+void clearCombinedEvents(Dropset *dropset)
+{
+  dropset->numberOfAcquiredPrimeE = 0;
+  dropset->numberOfComplexEvents = 0;
+  dropset->numberOfComplexBips = 0;
+}
 
-  if(dropset->taxaToDrop)
-    freeIndexList(dropset->taxaToDrop);
 
-  /* free combined events */
-  if(dropset->complexEvents)
-    freeListFlat(dropset->complexEvents);
+/* appends the own events of from to those of to */
+void moveOwnEvents(Dropset *from, Dropset *to)
+{
+  int
+    i;
 
-  if( dropset->acquiredPrimeE)
-    freeListFlat(dropset->acquiredPrimeE);
+  FOR_0_LIMIT(i, from->numberOfOwnPrimeE)
+    *appendOwnEvent(to) = from->ownPrimeE[i];
 
-  /* ownPrimeE */
-  iter = dropset->ownPrimeE;
-  while(iter)
+  from->numberOfOwnPrimeE = 0;
+  forgetPrimeBips(from);
+  forgetPrimeBips(to);
+}
+
+
+/* a zeroed dropset */
+Dropset *allocDropset(void)
+{
+  PooledDropset
+    *result = freeDropsets;
+
+  if(result)
+    {
+      freeDropsets = result->next;
+      memset(result, 0, sizeof(PooledDropset));
+    }
+  else
     {
-      List *next = iter->next;
-      free((MergingEvent*)iter->value);
-      iter = next;
+      if( NOT dropsetArena)
+        dropsetArena = createArena(256 * sizeof(PooledDropset));
+      result = arenaAlloc(dropsetArena, sizeof(PooledDropset));
     }
-  freeListFlat(dropset->ownPrimeE);
 
-  free(dropset);
+  return &result->dropset;
+}
+
+
+void freeDropsetDeep(void *value)
+{
+  PooledDropset
+    *pooled = (PooledDropset*) value;
+
+  Dropset
+    *dropset = &pooled->dropset;
+
+  free(dropset->ownPrimeE);
+  free(dropset->acquiredPrimeE);
+  free(dropset->complexEvents);
+  free(dropset->complexBips);
+  free(dropset->primeBips);
+  freeTaxonSet(&dropset->taxaToDrop);
+
+  pooled->next = freeDropsets;
+  freeDropsets = pooled;
+}
+
+
+void freeDropsetPool(void)
+{
+  if(dropsetArena)
+    destroyArena(dropsetArena);
+  dropsetArena = NULL;
+  freeDropsets = NULL;
 }
 
 
@@ -275,30 +386,187 @@ void printMergingEventStruct(MergingEvent **mergingEvents, int mxtips)
 }
 #endif
 
-uint32_t dropsetHashValue(HashTable *hashTable, void *value)
+uint32_t taxonSetHashValue(const TaxonSet *set)
 {
   uint32_t
     result = 0;
 
-  Dropset *dropset = (Dropset*)value;
-  IndexList *iter = dropset->taxaToDrop;
+  const int
+    *taxa = GET_TAXA(set);
 
-  FOR_LIST(iter)
-  {
-    assert(iter->index < mxtips);
-    result ^= randForTaxa[ iter->index ];
-  }
+  int
+    i;
+
+  FOR_0_LIMIT(i, set->numberOfTaxa)
+    {
+      assert(taxa[i] < mxtips);
+      result ^= randForTaxa[taxa[i]];
+    }
 
   return result;
 }
 
 
-boolean dropsetEqual(HashTable *hashtable, void *entryA, void *entryB)
+void freeTaxonSet(TaxonSet *set)
+{
+  if(set->numberOfTaxa > INLINE_DROPSET_SIZE)
+    free(set->taxa.allocated);
+  set->numberOfTaxa = 0;
+}
+
+
+boolean taxonSetEqual(const TaxonSet *setA, const TaxonSet *setB)
+{
+  return setA->numberOfTaxa == setB->numberOfTaxa
+    && NOT memcmp(GET_TAXA(setA), GET_TAXA(setB), setA->numberOfTaxa * sizeof(int));
+}
+
+
+/* orders sets by size and then by their taxa; negative, if setA comes
+   first */
+int compareTaxonSets(const TaxonSet *setA, const TaxonSet *setB)
+{
+  const int
+    *taxaA = GET_TAXA(setA),
+    *taxaB = GET_TAXA(setB);
+
+  int
+    i;
+
+  if(setA->numberOfTaxa != setB->numberOfTaxa)
+    return setA->numberOfTaxa - setB->numberOfTaxa;
+
+  FOR_0_LIMIT(i, setA->numberOfTaxa)
+    if(taxaA[i] != taxaB[i])
+      return taxaA[i] - taxaB[i];
+
+  return 0;
+}
+
+
+boolean taxonSetIsSubsetOf(const TaxonSet *subset, const TaxonSet *set)
+{
+  const int
+    *subsetTaxa = GET_TAXA(subset),
+    *taxa = GET_TAXA(set);
+
+  int
+    i,
+    j = 0;
+
+  if(subset->numberOfTaxa > set->numberOfTaxa)
+    return FALSE;
+
+  FOR_0_LIMIT(i, subset->numberOfTaxa)
+    {
+      while(j < set->numberOfTaxa && taxa[j] < subsetTaxa[i])
+        j++;
+
+      if(j == set->numberOfTaxa || taxa[j] != subsetTaxa[i])
+        return FALSE;
+
+      j++;
+    }
+
+  return TRUE;
+}
+
+
+boolean taxonSetsIntersect(const TaxonSet *setA, const TaxonSet *setB)
+{
+  const int
+    *taxaA = GET_TAXA(setA),
+    *taxaB = GET_TAXA(setB);
+
+  int
+    i = 0,
+    j = 0;
+
+  while(i < setA->numberOfTaxa && j < setB->numberOfTaxa)
+    {
+      if(taxaA[i] == taxaB[j])
+        return TRUE;
+
+      if(taxaA[i] < taxaB[j])
+        i++;
+      else
+        j++;
+    }
+
+  return FALSE;
+}
+
+
+/* removes the taxa of subtract from set. A set that becomes small
+   enough moves its taxa inline. */
+void taxonSetMinus(TaxonSet *set, const TaxonSet *subtract)
+{
+  const int
+    *subtractTaxa = GET_TAXA(subtract);
+
+  int
+    i,
+    j = 0,
+    count = 0,
+    *taxa = GET_TAXA(set);
+
+  FOR_0_LIMIT(i, set->numberOfTaxa)
+    {
+      while(j < subtract->numberOfTaxa && subtractTaxa[j] < taxa[i])
+        j++;
+
+      if(j == subtract->numberOfTaxa || subtractTaxa[j] != taxa[i])
+        taxa[count++] = taxa[i];
+    }
+
+  if(set->numberOfTaxa > INLINE_DROPSET_SIZE && count <= INLINE_DROPSET_SIZE)
+    {
+      memcpy(set->taxa.inlined, taxa, count * sizeof(int));
+      free(taxa);
+    }
+
+  set->numberOfTaxa = count;
+}
+
+
+/* the taxa are printed from the largest one on */
+void printTaxonSet(const TaxonSet *set)
+{
+  const int
+    *taxa = GET_TAXA(set);
+
+  int
+    i;
+
+  PR(">");
+  for(i = set->numberOfTaxa; i--; )
+    PR("%d,", taxa[i]);
+  PR("<");
+}
+
+
+void printTaxonSetToFile(FILE *file, const TaxonSet *set)
 {
-  IndexList *aList = ((Dropset*)entryA)->taxaToDrop,
-    *bList = ((Dropset*)entryB)->taxaToDrop;
+  const int
+    *taxa = GET_TAXA(set);
+
+  int
+    i;
+
+  for(i = set->numberOfTaxa; i--; )
+    fprintf(file, "%s%i", i == set->numberOfTaxa - 1 ? "" : ",", taxa[i]);
+}
+
 
-  return indexListEqual(aList, bList);
+uint32_t dropsetHashValue(HashTable *hashTable, void *value)
+{
+  return taxonSetHashValue(&((Dropset*)value)->taxaToDrop);
+}
+
+
+boolean dropsetEqual(HashTable *hashtable, void *entryA, void *entryB)
+{
+  return taxonSetEqual(&((Dropset*)entryA)->taxaToDrop, &((Dropset*)entryB)->taxaToDrop);
 }
 
 
@@ -323,58 +591,111 @@ boolean elementsEqual(ProfileElem *elemA,ProfileElem *elemB, int a, int b)
 }
 
 
-IndexList *getDropset(ProfileElem *elemA, ProfileElem *elemB, boolean complement, BitVector *neglectThose)
+/* the dropset of elemA and elemB (in result), if they differ in numBit
+   taxa that may be dropped */
+boolean getDropsetTaxa(ProfileElem *elemA, ProfileElem *elemB, boolean complement, int numBit, BitVector *neglectThose, TaxonSet *result)
 {
-  int i,j,
-    numBit = 0,
-    localBitCount,
+  int i,
+    count = 0,
+    *taxa;
+
+  BitVector
     differenceByte;
 
-  IndexList
-    *result = NULL;
+  if(numBit > maxDropsetSize)
+    return FALSE;
 
-  if(elemA == elemB)
-    return NULL;
+  assert(numBit);
+
+  result->numberOfTaxa = numBit;
+  if(numBit > INLINE_DROPSET_SIZE)
+    result->taxa.allocated = CALLOC(numBit, sizeof(int));
+  taxa = GET_TAXA(result);
 
-  FOR_0_LIMIT(i,bitVectorLength)
+  for(i = 0; count < numBit; ++i)
     {
       if( complement)
 	differenceByte = ~ ((elemA->bitVector[i] ^ elemB->bitVector[i]) |  ( droppedTaxa[i] | paddingBits[i] ));
       else
 	differenceByte = elemA->bitVector[i] ^ elemB->bitVector[i];
 
-      localBitCount = BIT_COUNT(differenceByte);
-
-      if( (numBit += localBitCount) > maxDropsetSize)
+      while(differenceByte)
 	{
-	  freeIndexList(result);
-	  return NULL;
-	}
-
-      if( NOT localBitCount)
-	continue;
-
-      FOR_0_LIMIT(j,MASK_LENGTH)
-	{
-	  if(NOT localBitCount)
-	    break;
+	  int
+	    taxon = i * MASK_LENGTH + __builtin_ctz(differenceByte);
 
-	  if(NTH_BIT_IS_SET_IN_INT(differenceByte,j))
+	  if(NOT NTH_BIT_IS_SET(neglectThose, taxon))
 	    {
-	      APPEND_INT((( i * MASK_LENGTH) + j),result);
-	      localBitCount--;
-
-	      if(NOT NTH_BIT_IS_SET(neglectThose, (i*MASK_LENGTH + j)))
-		{
-		  freeIndexList(result);
-		  return NULL;
-		}
+	      freeTaxonSet(result);
+	      return FALSE;
 	    }
+
+	  taxa[count++] = taxon;
+	  differenceByte &= differenceByte - 1;
 	}
     }
 
-  assert(numBit);
+  return TRUE;
+}
 
-  return result;
+
+/* a single taxon dropset requires, that the fingerprints differ by
+   the key of this taxon */
+static boolean fingerprintsDifferByOneTaxon(ProfileElem *elemA, ProfileElem *elemB, boolean complement)
+{
+  uint64_t
+    difference = elemA->fingerprint ^ elemB->fingerprint;
+
+  if(complement)
+    difference ^= remainingFingerprint;
+
+  return findTaxonByKey(difference) >= 0;
 }
 
+
+/* compares elemA with a block of candidates. counts[j] is the number
+   of taxa in which elemA and the j-th candidate differ and
+   complementCounts[j] that for the complement of elemA (whose
+   signature is only given, if this is relevant). A count above
+   maxDropsetSize means that there is no dropset. Most pairs are
+   rejected by their signatures, the counts of the others are computed
+   in one pass. */
+void getDifferenceCounts(ProfileElem *elemA, const uint8_t *complementSignature,
+                         ProfileElem **candidates, int numberOfCandidates,
+                         int *counts, int *complementCounts)
+{
+  int
+    j,
+    signatureLength = getSignatureLength(bitVectorLength),
+    rejected = maxDropsetSize + 1;
+
+  FOR_0_LIMIT(j, numberOfCandidates)
+    {
+      ProfileElem
+        *elemB = candidates[j];
+
+      boolean
+        checkNormal = elemA != elemB
+          && signatureDistance(elemA->signature, elemB->signature, signatureLength) <= maxDropsetSize,
+        checkComplement = complementSignature && elemA != elemB
+          && signatureDistance(complementSignature, elemB->signature, signatureLength) <= maxDropsetSize;
+
+      if(maxDropsetSize == 1)
+        {
+          checkNormal = checkNormal && fingerprintsDifferByOneTaxon(elemA, elemB, FALSE);
+          checkComplement = checkComplement && fingerprintsDifferByOneTaxon(elemA, elemB, TRUE);
+        }
+
+      counts[j] = rejected;
+      complementCounts[j] = rejected;
+
+      if(checkNormal && checkComplement)
+        differenceBitCounts(elemA->bitVector, elemB->bitVector, droppedTaxa, paddingBits,
+                            bitVectorLength, maxDropsetSize, counts + j, complementCounts + j);
+      else if(checkNormal)
+        counts[j] = xorBitCount(elemA->bitVector, elemB->bitVector, bitVectorLength, maxDropsetSize);
+      else if(checkComplement)
+        complementCounts[j] = xnorBitCount(elemA->bitVector, elemB->bitVector, droppedTaxa, paddingBits,
+                                           bitVectorLength, maxDropsetSize);
+    }
+}
@@ -38,11 +38,18 @@
 #include "List.h"
 #include "ProfileElem.h"
 #include "HashTable.h"
+#include "Arena.h"
 
+/* the bipartitions of a complex event are a range of the complexBips
+   of its dropset */
 typedef union _mergeBips
 {
   int pair[2];
-  IndexList *many; 
+  struct
+  {
+    int offset;
+    int length;
+  } many;
 } MergingBipartitions;
 
 typedef struct _mergingEvent
@@ -55,28 +62,83 @@ typedef struct _mergingEvent
 }  MergingEvent;
 
 
+/* dropsets of up to that many taxa keep them inline */
+#define INLINE_DROPSET_SIZE 8
+
+/* the taxa of a dropset in ascending order. A larger set keeps them in
+   an array of its own, that freeTaxonSet releases. */
+typedef struct
+{
+  int numberOfTaxa;
+  union
+  {
+    int inlined[INLINE_DROPSET_SIZE];
+    int *allocated;
+  } taxa;
+} TaxonSet;
+
+#define GET_TAXA(set) ((set)->numberOfTaxa > INLINE_DROPSET_SIZE ? (set)->taxa.allocated : (set)->taxa.inlined)
+
 typedef struct dropset
 {
-  IndexList *taxaToDrop;
+  TaxonSet taxaToDrop;
   int improvement;
   
-  List *ownPrimeE; 
-  List *acquiredPrimeE; 
-  List *complexEvents; 
+  /* the events are kept in vectors. The acquired events (pointers
+     into the ownPrimeE of this dropset and its subsets) and the
+     complex ones are rebuilt every round, their vectors are reused */
+  MergingEvent *ownPrimeE;
+  int numberOfOwnPrimeE;
+  int ownPrimeECapacity;
+
+  MergingEvent **acquiredPrimeE;
+  int numberOfAcquiredPrimeE;
+  int acquiredPrimeECapacity;
+
+  MergingEvent *complexEvents;
+  int numberOfComplexEvents;
+  int complexEventsCapacity;
+
+  int *complexBips;
+  int numberOfComplexBips;
+  int complexBipsCapacity;
+
+  /* the bipartitions of ownPrimeE (plus one, open addressing), NULL
+     if it has to be rebuilt */
+  uint32_t *primeBips;
+  uint32_t primeBipsMask;
+  uint32_t numberOfPrimeBips;
 } Dropset;
 
+/* the bipartitions of a complex event of the dropset */
+#define GET_COMPLEX_BIPS(dropset,me) ((dropset)->complexBips + (me)->mergingBipartitions.many.offset)
+#define GET_FIRST_BIP(dropset,me) ((me)->isComplex ? GET_COMPLEX_BIPS(dropset,me)[0] : (me)->mergingBipartitions.pair[0])
+
 
 boolean dropsetEqual(HashTable *hashtable, void *entryA, void *entryB);
 uint32_t dropsetHashValue(HashTable *hashTable, void *value);
-void removeMergingEvent(Dropset *dropset, List *toBeRemoved);  
-List *freeMergingEventReturnNext(List *elem); 
 void removeDropsetAndRelated(HashTable *mergingHash, Dropset *dropset);
 void addEventToDropsetPrime(Dropset *dropset, int a, int b);
-List *addEventToDropsetCombining(List *complexEvents, MergingBipartitions primeEvent);
-void freeDropsetDeepInHash(void *value);
-void freeDropsetDeepInEnd(void *value);
-void addEventToDropsetForCombining(Dropset *dropset, IndexList *mergingBips);
+void forgetPrimeBips(Dropset *dropset);
+void addAcquiredEvent(Dropset *dropset, MergingEvent *me);
+void addComplexEvent(Dropset *dropset, IndexList *component);
+void clearCombinedEvents(Dropset *dropset);
+void moveOwnEvents(Dropset *from, Dropset *to);
 void initializeRandForTaxa(int mxtips);
-void freeDropsetDeep(void *values, boolean freeCombinedM);
-IndexList *getDropset(ProfileElem *elemA, ProfileElem *elemB, boolean complement, BitVector *neglectThose);
+void initializeTaxonKeys(int mxtips);
+void freeTaxonKeys(void);
+Dropset *allocDropset(void);
+void freeDropsetDeep(void *value);
+void freeDropsetPool(void);
+boolean getDropsetTaxa(ProfileElem *elemA, ProfileElem *elemB, boolean complement, int numBit, BitVector *neglectThose, TaxonSet *result);
+uint32_t taxonSetHashValue(const TaxonSet *set);
+void freeTaxonSet(TaxonSet *set);
+boolean taxonSetEqual(const TaxonSet *setA, const TaxonSet *setB);
+int compareTaxonSets(const TaxonSet *setA, const TaxonSet *setB);
+boolean taxonSetIsSubsetOf(const TaxonSet *subset, const TaxonSet *set);
+boolean taxonSetsIntersect(const TaxonSet *setA, const TaxonSet *setB);
+void taxonSetMinus(TaxonSet *set, const TaxonSet *subtract);
+void printTaxonSet(const TaxonSet *set);
+void printTaxonSetToFile(FILE *file, const TaxonSet *set);
+void getDifferenceCounts(ProfileElem *elemA, const uint8_t *complementSignature, ProfileElem **candidates, int numberOfCandidates, int *counts, int *complementCounts);
 #endif
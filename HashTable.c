@@ -33,57 +33,111 @@
 #include <pthread.h>
 #endif
 
+
+static uint32_t homeSlot(HashTable *hashTable, uint32_t fullKey)
+{
+  /* the keys may be consecutive numbers, thus they are mixed first */
+  fullKey ^= fullKey >> 16;
+  fullKey *= 0x45d9f3bU;
+  fullKey ^= fullKey >> 16;
+
+  return fullKey & (hashTable->tableSize - 1);
+}
+
+
+/* returns the slot of the entry (with a NULL value, any entry with the
+   key matches) or the empty slot where the probing stopped */
+static uint32_t findSlot(HashTable *hashTable, void *value, uint32_t fullKey)
+{
+  uint32_t
+    mask = hashTable->tableSize - 1,
+    position = homeSlot(hashTable, fullKey);
+
+  while(hashTable->slots[position])
+    {
+      HashElem
+        *elem = hashTable->entries + hashTable->slots[position] - 1;
+
+      if(elem->fullKey == fullKey
+         && (NOT value || hashTable->equalFunction(hashTable, elem->value, value)))
+        break;
+
+      position = (position + 1) & mask;
+    }
+
+  return position;
+}
+
+
+static void rebuildSlots(HashTable *hashTable)
+{
+  uint32_t
+    i,
+    mask = hashTable->tableSize - 1;
+
+  memset(hashTable->slots, 0, hashTable->tableSize * sizeof(uint32_t));
+
+  FOR_0_LIMIT(i, hashTable->usedEntries)
+    if(hashTable->entries[i].value)
+      {
+        uint32_t
+          position = homeSlot(hashTable, hashTable->entries[i].fullKey);
+
+        while(hashTable->slots[position])
+          position = (position + 1) & mask;
+
+        hashTable->slots[position] = i + 1;
+      }
+}
+
+
+/* squeezes the holes of removed entries out of the vector (keeping the
+   order of the others) */
+static void compactEntries(HashTable *hashTable)
+{
+  uint32_t
+    i,
+    count = 0;
+
+  FOR_0_LIMIT(i, hashTable->usedEntries)
+    if(hashTable->entries[i].value)
+      hashTable->entries[count++] = hashTable->entries[i];
+
+  assert(count == hashTable->entryCount);
+  hashTable->usedEntries = count;
+}
+
+
 HashTable *createHashTable(uint32_t size,
 			   void *commonAttr,
 			   uint32_t (*hashFunction)(HashTable *hash_table, void *value),
 			   boolean (*equalFunction)(HashTable *hash_table, void *entryA, void *entryB))
 {
-  static const uint32_t
-    initTable[] = {64, 128, 256, 512, 1024, 2048, 4096,
-		   8192, 16384, 32768, 65536, 131072,
-		   262144, 524288, 1048576, 2097152,
-		   4194304, 8388608, 16777216, 33554432,
-		   67108864, 134217728, 268435456,
-		   536870912, 1073741824, 2147483648U};
-
   HashTable
     *hashTable = CALLOC(1, sizeof(HashTable));
 
   uint32_t
-    tableSize,
-    i,
-#ifdef DEBUG
-    maxSize = (uint32_t)-1,
-#endif
-    primeTableLength = sizeof(initTable)/sizeof(initTable[0]);
+    tableSize = 64;
 
   hashTable->hashFunction = hashFunction;
   hashTable->equalFunction = equalFunction;
   hashTable->commonAttributes = commonAttr;
 
-#ifdef DEBUG
-  assert(size <= maxSize);
-#endif
-  for(i = 0; initTable[i] < size && i < primeTableLength; ++i);
-  assert(i < primeTableLength);
-
-  tableSize = initTable[i];
+  /* size is the number of entries expected, the table grows if needed */
+  hashTable->capacity = MAX(size, 16);
+  while(tableSize < 2 * hashTable->capacity)
+    tableSize *= 2;
 
 #ifdef PARALLEL
-  hashTable->cntLock = CALLOC(1,sizeof(pthread_mutex_t));
-  pthread_mutex_init(hashTable->cntLock, (pthread_mutexattr_t *)NULL);
-
-  hashTable->lockPerSlot = (pthread_mutex_t**)CALLOC(tableSize,sizeof(pthread_mutex_t*));
-  FOR_0_LIMIT(i, tableSize)
-    {
-      hashTable->lockPerSlot[i] = (pthread_mutex_t*) CALLOC(1,sizeof(pthread_mutex_t));
-      pthread_mutex_init(hashTable->lockPerSlot[i], (pthread_mutexattr_t *)NULL);
-    }
+  hashTable->lock = CALLOC(1,sizeof(pthread_mutex_t));
+  pthread_mutex_init(hashTable->lock, (pthread_mutexattr_t *)NULL);
 #endif
 
-  hashTable->table = CALLOC(tableSize, sizeof(HashElem*));
+  hashTable->entries = CALLOC(hashTable->capacity, sizeof(HashElem));
+  hashTable->slots = CALLOC(tableSize, sizeof(uint32_t));
   hashTable->tableSize = tableSize;
   hashTable->entryCount = 0;
+  hashTable->usedEntries = 0;
 
   return hashTable;
 }
@@ -93,239 +147,171 @@ HashTable *createHashTable(uint32_t size,
 boolean removeElementFromHash(HashTable *hashtable, void *value)
 {
   uint32_t
+    mask = hashtable->tableSize - 1,
     hashValue = hashtable->hashFunction(hashtable, value),
-    position = hashValue % hashtable->tableSize;
-
-  HashElem *elem = hashtable->table[position];
+    position = findSlot(hashtable, value, hashValue),
+    i,
+    j;
 
-  if( NOT elem )
+  if( NOT hashtable->slots[position])
     {
       assert(0);
       return FALSE;
     }
 
-  if(
-     elem->fullKey == hashValue &&
-     hashtable->equalFunction(hashtable, elem->value, value))
-    {
-      hashtable->table[position] = elem->next ;
-      free(elem);
-      hashtable->entryCount-- ;
+  hashtable->entries[hashtable->slots[position] - 1].value = NULL;
+  hashtable->entryCount--;
 
-      return TRUE;
-    }
+  while(hashtable->usedEntries && NOT hashtable->entries[hashtable->usedEntries - 1].value)
+    hashtable->usedEntries--;
 
-  while(elem->next)
+  /* shift the following entries of the probe sequence back, s.t. no
+     tombstones are needed */
+  for(i = position, j = (position + 1) & mask;
+      hashtable->slots[j];
+      j = (j + 1) & mask)
     {
-      if(elem->next->fullKey == hashValue && hashtable->equalFunction(hashtable, elem->next->value, value))
-	{
-	  void *nextOne = elem->next->next;
-	  free(elem->next);
-	  elem->next = nextOne;
-	  hashtable->entryCount-- ;
-	  return TRUE;
-	}
-      elem = elem->next;
+      uint32_t
+        home = homeSlot(hashtable, hashtable->entries[hashtable->slots[j] - 1].fullKey);
+
+      if(((j - home) & mask) >= ((j - i) & mask))
+        {
+          hashtable->slots[i] = hashtable->slots[j];
+          i = j;
+        }
     }
 
-  return FALSE;
+  hashtable->slots[i] = 0;
+
+  return TRUE;
 }
 
 
 void *searchHashTableWithInt(HashTable *hashtable, uint32_t hashValue)
 {
   uint32_t
-    position = hashValue % hashtable->tableSize;
+    position = findSlot(hashtable, NULL, hashValue);
 
-  HashElem
-    *elem;
-
-  for(elem = hashtable->table[position];
-      elem;
-      elem = elem->next)
-    if(elem->fullKey  == hashValue)
-      return  elem->value;
-
-  return NULL;
+  return hashtable->slots[position]
+    ? hashtable->entries[hashtable->slots[position] - 1].value
+    : NULL;
 }
 
 
 void *searchHashTable(HashTable *hashtable, void *value, uint32_t hashValue)
 {
   uint32_t
-    position = hashValue % hashtable->tableSize;
-
-  HashElem
-    *elem;
+    position = findSlot(hashtable, value, hashValue);
 
-  for(elem = hashtable->table[position];
-      elem;
-      elem = elem->next)
-    if(elem->fullKey  == hashValue &&
-       hashtable->equalFunction(hashtable, elem->value, value))
-      return  elem->value;
-
-  return NULL;
+  return hashtable->slots[position]
+    ? hashtable->entries[hashtable->slots[position] - 1].value
+    : NULL;
 }
 
 
 void insertIntoHashTable(HashTable *hashTable, void *value, uint32_t index)
 {
-  /* just copied this */
-  HashElem
-    *hashElem = CALLOC(1, sizeof(HashElem));
-
-  hashElem->fullKey = index;
-
-  index =  hashElem->fullKey % hashTable->tableSize;
-
-  hashElem->value = value;
-  hashElem->next = hashTable->table[index];
-  hashTable->table[index] = hashElem;
-#ifdef PARALLEL
-  pthread_mutex_lock(hashTable->cntLock);
-  hashTable->entryCount++;
-  pthread_mutex_unlock(hashTable->cntLock);
-#else
-  hashTable->entryCount++;
-#endif
-}
-
-
-void destroyHashTable(HashTable *hashTable, void (*freeValue)(void *value))
-{
-  unsigned
-    int i;
+  uint32_t
+    mask,
+    position;
 
-  HashElem
-    *elemA,
-    *elemB,
-    **table = hashTable->table;
+  assert(value);
 
-  for(i = 0; i < hashTable->tableSize; ++i)
+  if(hashTable->usedEntries == hashTable->capacity)
     {
-      elemA = table[i];
-      while(elemA != NULL)
-	{
-	  elemB = elemA;
-	  elemA = elemA->next;
-	  if(freeValue)
-	    freeValue(elemB->value);
-	  free(elemB);
-	}
+      /* reuse the holes, if there are enough of them */
+      if(2 * hashTable->entryCount <= hashTable->capacity)
+        compactEntries(hashTable);
+      else
+        {
+          hashTable->capacity *= 2;
+          hashTable->entries = realloc(hashTable->entries, (size_t)hashTable->capacity * sizeof(HashElem));
+        }
+      rebuildSlots(hashTable);
     }
 
-#ifdef PARALLEL
-  pthread_mutex_destroy(hashTable->cntLock);
-  free(hashTable->cntLock);
-
-  FOR_0_LIMIT(i,hashTable->tableSize)
+  /* keep the load factor below 1/2 */
+  if(2 * (hashTable->entryCount + 1) > hashTable->tableSize)
     {
-      pthread_mutex_destroy(hashTable->lockPerSlot[i]);
-      free(hashTable->lockPerSlot[i]);
+      hashTable->tableSize *= 2;
+      free(hashTable->slots);
+      hashTable->slots = CALLOC(hashTable->tableSize, sizeof(uint32_t));
+      rebuildSlots(hashTable);
     }
-  free(hashTable->lockPerSlot);
-#endif
 
-  free(hashTable->commonAttributes);
-  free(hashTable->table);
-  free(hashTable);
+  mask = hashTable->tableSize - 1;
+  position = homeSlot(hashTable, index);
+  while(hashTable->slots[position])
+    position = (position + 1) & mask;
+
+  hashTable->entries[hashTable->usedEntries].fullKey = index;
+  hashTable->entries[hashTable->usedEntries].value = value;
+  hashTable->slots[position] = ++hashTable->usedEntries;
+  hashTable->entryCount++;
 }
 
 
-void updateEntryCount(HashTable *hashTable)
+void destroyHashTable(HashTable *hashTable, void (*freeValue)(void *value))
 {
   uint32_t
-    i,
-    result = 0;
+    i;
 
-  for(i = 0; i < hashTable->tableSize; ++i)
-    {
-      HashElem
-	*elem = ((HashElem**)hashTable->table)[i];
+  if(freeValue)
+    FOR_0_LIMIT(i, hashTable->usedEntries)
+      if(hashTable->entries[i].value)
+        freeValue(hashTable->entries[i].value);
 
-      while(elem)
-	{
-	  result++;
-	  elem = elem->next;
-	}
-    }
+#ifdef PARALLEL
+  pthread_mutex_destroy(hashTable->lock);
+  free(hashTable->lock);
+#endif
 
-  hashTable->entryCount = result;
+  free(hashTable->commonAttributes);
+  free(hashTable->entries);
+  free(hashTable->slots);
+  free(hashTable);
 }
 
 
 HashTableIterator *createHashTableIterator(HashTable *hashTable)
 {
-  unsigned
-    int i;
-
   HashTableIterator
     *hashTableIterator = CALLOC(1, sizeof(HashTableIterator));
 
   hashTableIterator->hashTable = hashTable;
-  hashTableIterator->hashElem = NULL;
-  hashTableIterator->index = hashTable->tableSize;
+  hashTableIterator->index = 0;
 
-  if( NOT hashTable->entryCount)
-    return hashTableIterator;
-
-  FOR_0_LIMIT(i,hashTable->tableSize)
-    {
-      if(hashTable->table[i])
-	{
-	  hashTableIterator->hashElem = hashTable->table[i];
-	  hashTableIterator->index = i;
-	  break;
-	}
-    }
+  while(hashTableIterator->index < hashTable->usedEntries
+        && NOT hashTable->entries[hashTableIterator->index].value)
+    hashTableIterator->index++;
 
   return hashTableIterator;
 }
 
+
 boolean hashTableIteratorNext(HashTableIterator *hashTableIterator)
 {
-  uint32_t
-    i,
-    tableSize = hashTableIterator->hashTable->tableSize;
-
-  HashElem
-    *next = hashTableIterator->hashElem->next;
-
-  if(next)
-    {
-      hashTableIterator->hashElem = next;
-      return TRUE;
-    }
-
-  i = hashTableIterator->index + 1;
-
-  if(i >= tableSize)
-    {
-      hashTableIterator->index = i;
-      return FALSE;
-    }
+  HashTable
+    *hashTable = hashTableIterator->hashTable;
 
-  while( NOT (next = hashTableIterator->hashTable->table[i]))
-    {
-      if( ++i >= tableSize)
-	{
-	  hashTableIterator->index = i;
-	  return FALSE;
-	}
-    }
+  if(hashTableIterator->index >= hashTable->usedEntries)
+    return FALSE;
 
-  hashTableIterator->index = i;
-  hashTableIterator->hashElem = next;
+  do
+    hashTableIterator->index++;
+  while(hashTableIterator->index < hashTable->usedEntries
+        && NOT hashTable->entries[hashTableIterator->index].value);
 
-  return next != NULL ;
+  return hashTableIterator->index < hashTable->usedEntries;
 }
 
 
 void *getCurrentValueFromHashTableIterator(HashTableIterator *hashTableIterator)
 {
-  return ((hashTableIterator->hashElem)
-	  ?  hashTableIterator->hashElem->value
+  HashTable
+    *hashTable = hashTableIterator->hashTable;
+
+  return ((hashTableIterator->index < hashTable->usedEntries)
+	  ?  hashTable->entries[hashTableIterator->index].value
 	  : NULL);
 }
-
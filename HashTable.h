@@ -38,31 +38,36 @@
 #include "common.h"
 
 
-typedef struct hash_el
+/* the entries are kept in insertion order in a dense vector, an
+   open-addressed index (linear probing) maps the keys onto them. Removed
+   entries leave a hole (value NULL) in the vector, that is squeezed out
+   the next time the vector is full. */
+typedef struct
 {
   uint32_t fullKey;
   void *value;
-  struct hash_el *next;
 } HashElem;
 
 typedef struct hash_table
 {
   uint32_t tableSize;
   uint32_t entryCount;
+  uint32_t usedEntries;
+  uint32_t capacity;
   void *commonAttributes;
   uint32_t (*hashFunction)(struct hash_table *h, void *value);
   boolean (*equalFunction)(struct hash_table *hashtable, void *entrA, void *entryB);
-  HashElem **table;
+  HashElem *entries;
+  uint32_t *slots;
 #ifdef PARALLEL
-  pthread_mutex_t **lockPerSlot;
-  pthread_mutex_t *cntLock;
+  /* an insertion may move all entries, thus the whole table is locked */
+  pthread_mutex_t *lock;
 #endif
 } HashTable;
 
 typedef struct
 {
   HashTable *hashTable;
-  HashElem *hashElem;
   uint32_t index;
 } HashTableIterator;
 
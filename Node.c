@@ -31,15 +31,43 @@
 #include "Node.h"
 
 
-IndexList *findAnIndependentComponent(HashTable *allNodes, Node *thisNode)
+/* the nodes and their lists live in the arena */
+static IndexList *prependIndexInArena(Arena *arena, int index, IndexList *list)
+{
+  IndexList
+    *listElem = arenaAlloc(arena, sizeof(IndexList));
+
+  listElem->index = index;
+  listElem->next = list;
+
+  return listElem;
+}
+
+
+void addEdgeToNode(HashTable *allNodes, Arena *arena, int id, int neighbor)
+{
+  Node
+    *node = searchHashTableWithInt(allNodes, id);
+
+  if( NOT node)
+    {
+      node = arenaAlloc(arena, sizeof(Node));
+      node->id = id;
+      insertIntoHashTable(allNodes, node, id);
+    }
+
+  node->edges = prependIndexInArena(arena, neighbor, node->edges);
+}
+
+
+IndexList *findAnIndependentComponent(HashTable *allNodes, Node *thisNode, Arena *arena)
 {
   if(thisNode->visited)
     return NULL; 
 
   IndexList *iter  = thisNode->edges;   
   thisNode->visited = TRUE;
-  IndexList *result = NULL; 
-  APPEND_INT(thisNode->id, result);
+  IndexList *result = prependIndexInArena(arena, thisNode->id, NULL);
 
   FOR_LIST(iter)
   {
@@ -47,7 +75,7 @@ IndexList *findAnIndependentComponent(HashTable *allNodes, Node *thisNode)
     
     if(  NOT found->visited)
       {
-	IndexList *list = findAnIndependentComponent(allNodes, found);
+	IndexList *list = findAnIndependentComponent(allNodes, found, arena);
 	result = concatenateIndexList(list, result);
       }
   }
@@ -56,15 +84,6 @@ IndexList *findAnIndependentComponent(HashTable *allNodes, Node *thisNode)
 }
 
 
-void freeNode(void *value)
-{
-  Node *node = value; 
-  freeIndexList(node->edges);
-  free(node);
-}
-
-
-
 boolean nodeEqual(HashTable *hashTable, void *entryA, void *entryB)
 {
   return ((Node*)entryA)->id  == ((Node*)entryB)->id;  
@@ -34,6 +34,7 @@
 #include "common.h"
 #include "List.h"
 #include "HashTable.h"
+#include "Arena.h"
 
 typedef struct _node
 {
@@ -44,8 +45,8 @@ typedef struct _node
 
 boolean nodeEqual(HashTable *hashTable, void *entryA, void *entryB);
 uint32_t nodeHashValue(HashTable *hashTable, void *value);
-void freeNode(void *value);
-IndexList *findAnIndependentComponent(HashTable *allNodes, Node *thisNode);
+void addEdgeToNode(HashTable *allNodes, Arena *arena, int id, int neighbor);
+IndexList *findAnIndependentComponent(HashTable *allNodes, Node *thisNode, Arena *arena);
 
 
 #endif
@@ -0,0 +1,408 @@
+/*  RogueNaRok is an algorithm for the identification of rogue taxa in a set of phylogenetic trees.
+ *
+ *  Moreover, the program collection comes with efficient implementations of
+ *   * the unrooted leaf stability by Thorley and Wilkinson
+ *   * the taxonomic instability index by Maddinson and Maddison
+ *   * a maximum agreement subtree implementation (MAST) for unrooted trees
+ *   * a tool for pruning taxa from a tree collection.
+ *
+ *  Copyright October 2011 by Andre J. Aberer
+ *
+ *  Tree I/O and parallel framework are derived from RAxML by Alexandros Stamatakis.
+ *
+ *  This program is free software; you may redistribute it and/or
+ *  modify its under the terms of the GNU General Public License as
+ *  published by the Free Software Foundation; either version 2 of the
+ *  License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  For any other inquiries send an Email to Andre J. Aberer
+ *  andre.aberer at googlemail.com
+ *
+ *  When publishing work that is based on the results from RogueNaRok, please cite:
+ *  Andre J. Aberer, Denis Krompaß, Alexandros Stamatakis. RogueNaRok: an Efficient and Exact Algorithm for Rogue Taxon Identification. (unpublished) 2011.
+ *
+ */
+
+#include "ProfileCache.h"
+#include "newFunctions.h"
+
+#ifndef WIN32
+#include <fcntl.h>
+#include <sys/stat.h>
+#endif
+
+#define PROFILE_CACHE_BYTE_ORDER 0x01020304
+#define ALIGN_TO_8(x) (((x) + 7) & ~((uint64_t)7))
+#define ALIGN_TO_64(x) (((x) + 63) & ~((uint64_t)63))
+
+#define FNV_OFFSET 14695981039346656037ULL
+#define FNV_PRIME 1099511628211ULL
+
+
+static uint64_t hashBuffer(uint64_t hash, const char *buffer, size_t length)
+{
+  size_t
+    i;
+
+  uint64_t
+    word;
+
+  hash ^= length;
+  hash *= FNV_PRIME;
+
+  /* word-wise, the trees may be large */
+  for(i = 0; i + sizeof(uint64_t) <= length; i += sizeof(uint64_t))
+    {
+      memcpy(&word, buffer + i, sizeof(uint64_t));
+      hash ^= word;
+      hash *= FNV_PRIME;
+      hash ^= hash >> 29;
+    }
+
+  for( ; i < length; ++i)
+    {
+      hash ^= (unsigned char)buffer[i];
+      hash *= FNV_PRIME;
+    }
+
+  return hash;
+}
+
+
+uint64_t hashTreeSources(TreeFile *bootstrapTrees, TreeFile *bestTree)
+{
+  uint64_t
+    hash = hashBuffer(FNV_OFFSET, bootstrapTrees->buffer, bootstrapTrees->length);
+
+  if(bestTree)
+    hash = hashBuffer(hash, bestTree->buffer, bestTree->length);
+
+  return hash;
+}
+
+
+static uint64_t getNamesSize(All *tr)
+{
+  uint64_t
+    result = 0;
+
+  int
+    i;
+
+  for(i = 1; i <= tr->mxtips; ++i)
+    result += strlen(tr->nameList[i]) + 1;
+
+  return ALIGN_TO_8(result);
+}
+
+
+#define GET_WEIGHTS_SIZE(header) ALIGN_TO_8((uint64_t)(header)->numberOfTreeColumns * sizeof(int32_t))
+
+
+/* the rows start at a cache line, s.t. they are aligned like the rows
+   of a store, when the cache is mapped */
+static uint64_t getBitVectorsOffset(const profileCacheHeader *header)
+{
+  return ALIGN_TO_64(sizeof(profileCacheHeader) + header->namesSize + GET_WEIGHTS_SIZE(header));
+}
+
+
+static uint64_t getCacheSize(const profileCacheHeader *header)
+{
+  return getBitVectorsOffset(header)
+    + ALIGN_TO_8((uint64_t)header->length * (header->bitVectorLength + header->treeVectorLength) * sizeof(BitVector))
+    + header->length;
+}
+
+
+static void fillHeader(profileCacheHeader *header, All *tr, uint32_t length, uint32_t numberOfTreeColumns,
+                       uint64_t sourceHash, boolean hasBestTree)
+{
+  memset(header, 0, sizeof(profileCacheHeader));
+  memcpy(header->magic, PROFILE_CACHE_MAGIC, sizeof(PROFILE_CACHE_MAGIC));
+  header->version = PROFILE_CACHE_VERSION;
+  header->byteOrder = PROFILE_CACHE_BYTE_ORDER;
+  header->sourceHash = sourceHash;
+  header->mxtips = tr->mxtips;
+  header->numberOfTrees = tr->numberOfTrees;
+  header->numberOfTreeColumns = numberOfTreeColumns;
+  header->hasBestTree = hasBestTree ? 1 : 0;
+  header->length = length;
+  header->bitVectorLength = getKernelBitVectorLength(tr->mxtips);
+  header->treeVectorLength = GET_BITVECTOR_LENGTH((numberOfTreeColumns+1));
+  header->namesSize = getNamesSize(tr);
+}
+
+
+static boolean isValidCache(All *tr, const char *content, uint64_t size, uint64_t sourceHash, boolean hasBestTree)
+{
+  profileCacheHeader
+    expected,
+    header;
+
+  const char
+    *name;
+
+  int
+    i;
+
+  if(size < sizeof(profileCacheHeader))
+    return FALSE;
+
+  memcpy(&header, content, sizeof(profileCacheHeader));
+  fillHeader(&expected, tr, header.length, header.numberOfTreeColumns, sourceHash, hasBestTree);
+
+  if(memcmp(&header, &expected, sizeof(profileCacheHeader))
+     || header.numberOfTreeColumns == 0
+     || header.numberOfTreeColumns > header.numberOfTrees
+     || size != getCacheSize(&header))
+    return FALSE;
+
+  name = content + sizeof(profileCacheHeader);
+  for(i = 1; i <= tr->mxtips; ++i)
+    {
+      if(strcmp(name, tr->nameList[i]))
+        return FALSE;
+      name += strlen(name) + 1;
+    }
+
+  return TRUE;
+}
+
+
+/* the store of the profile takes over block, the allocation (or the
+   mapping of size bytes) that content is in, and uses the rows in
+   there as they are */
+static Array *profileFromCache(All *tr, char *content, void *block, uint64_t size)
+{
+  profileCacheHeader
+    header;
+
+  uint32_t
+    i;
+
+  const int32_t
+    *weights;
+
+  BitVector
+    *bitVectors;
+
+  const BitVector
+    *treeVectors;
+
+  const char
+    *isInMLTree;
+
+  Array
+    *result;
+
+  BipartitionStore
+    *store;
+
+  memcpy(&header, content, sizeof(profileCacheHeader));
+
+  weights = (const int32_t*)(content + sizeof(profileCacheHeader) + header.namesSize);
+  bitVectors = (BitVector*)(content + getBitVectorsOffset(&header));
+  treeVectors = bitVectors + (uint64_t)header.length * header.bitVectorLength;
+  isInMLTree = (const char*)(treeVectors + (uint64_t)header.length * header.treeVectorLength);
+  isInMLTree = content + ALIGN_TO_8((uint64_t)(isInMLTree - content));
+
+  tr->numberOfTreeColumns = header.numberOfTreeColumns;
+  if(header.numberOfTreeColumns < header.numberOfTrees)
+    {
+      tr->treeWeights = CALLOC(header.numberOfTreeColumns, sizeof(int));
+      FOR_0_LIMIT(i, header.numberOfTreeColumns)
+        tr->treeWeights[i] = weights[i];
+    }
+
+  result = createBipartitionProfile(tr, header.length, bitVectors, block);
+  store = ((ProfileElemAttr*)result->commonAttributes)->store;
+  assert(store->bitVectorLength == header.bitVectorLength);
+#ifndef WIN32
+  store->mappedSize = size;
+#else
+  (void)size;
+#endif
+
+  FOR_0_LIMIT(i, header.length)
+    {
+      ProfileElem
+        *elem = store->elems + i;
+
+      initTreeSet(&elem->treeSet, treeVectors + (uint64_t)i * header.treeVectorLength, header.numberOfTreeColumns);
+
+      elem->isInMLTree = isInMLTree[i] ? TRUE : FALSE;
+      elem->fingerprint = bitVectorFingerprint(elem->bitVector, store->bitVectorLength);
+      elem->treeVectorSupport = weightedTreeSetSize(&elem->treeSet, GET_BITVECTOR_LENGTH(header.numberOfTreeColumns), tr->treeWeights);
+    }
+
+  return result;
+}
+
+
+/* returns the profile stored in fileName or NULL, if there is no
+   cache that matches the current input. The cache is mapped copy on
+   write, its rows become those of the store of the profile. */
+Array *loadProfileCache(All *tr, const char *fileName, uint64_t sourceHash, boolean hasBestTree)
+{
+  char
+    *content = NULL;
+
+  void
+    *block = NULL;
+
+  uint64_t
+    size = 0;
+
+#ifndef WIN32
+  int
+    fd = open(fileName, O_RDONLY);
+
+  struct stat
+    fileInfo;
+
+  if(fd < 0)
+    return NULL;
+
+  if(fstat(fd, &fileInfo) == 0 && fileInfo.st_size > 0)
+    {
+      void
+        *mapped = mmap(NULL, fileInfo.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+
+      if(mapped != MAP_FAILED)
+        {
+          content = block = mapped;
+          size = fileInfo.st_size;
+        }
+    }
+
+  close(fd);
+#else
+  FILE
+    *f = fopen(fileName, "rb");
+
+  if(NOT f)
+    return NULL;
+
+  fseek(f, 0, SEEK_END);
+  size = ftell(f);
+  rewind(f);
+  /* the rows of the cache start at a cache line, like in a mapping */
+  content = (char*)reallocAlignedRows(&block, NULL, 0, size);
+  if(fread(content, 1, size, f) != size)
+    size = 0;
+  fclose(f);
+#endif
+
+  if(content && isValidCache(tr, content, size, sourceHash, hasBestTree))
+    return profileFromCache(tr, content, block, size);
+
+#ifndef WIN32
+  if(block)
+    munmap(block, size);
+#else
+  free(block);
+#endif
+
+  return NULL;
+}
+
+
+/* the cache is written to a temporary file first, s.t. concurrent
+   runs never see a partial cache. Failing to write is not an error. */
+void writeProfileCache(All *tr, Array *bipartitionProfile, const char *fileName, uint64_t sourceHash, boolean hasBestTree)
+{
+  profileCacheHeader
+    header;
+
+  char
+    tmpName[1024],
+    padding[64] = {0};
+
+  uint32_t
+    i;
+
+  int
+    j,
+    nameLength;
+
+  boolean
+    ok;
+
+  uint64_t
+    namesBytes = 0,
+    offset,
+    vectorBytes;
+
+  BitVector
+    *treeVector;
+
+  FILE
+    *f;
+
+#ifndef WIN32
+  nameLength = snprintf(tmpName, sizeof(tmpName), "%s.%d.tmp", fileName, (int)getpid());
+#else
+  nameLength = snprintf(tmpName, sizeof(tmpName), "%s.tmp", fileName);
+#endif
+  if(nameLength < 0 || (size_t)nameLength >= sizeof(tmpName))
+    return;
+
+  f = fopen(tmpName, "wb");
+  if(NOT f)
+    return;
+
+  fillHeader(&header, tr, bipartitionProfile->length, tr->numberOfTreeColumns, sourceHash, hasBestTree);
+  ok = fwrite(&header, sizeof(profileCacheHeader), 1, f) == 1;
+
+  for(j = 1; j <= tr->mxtips; ++j)
+    {
+      ok = ok && fwrite(tr->nameList[j], strlen(tr->nameList[j]) + 1, 1, f) == 1;
+      namesBytes += strlen(tr->nameList[j]) + 1;
+    }
+  if(header.namesSize != namesBytes)
+    ok = ok && fwrite(padding, header.namesSize - namesBytes, 1, f) == 1;
+
+  FOR_0_LIMIT(i, header.numberOfTreeColumns)
+    {
+      int32_t
+        weight = tr->treeWeights ? tr->treeWeights[i] : 1;
+      ok = ok && fwrite(&weight, sizeof(int32_t), 1, f) == 1;
+    }
+  if(header.numberOfTreeColumns % 2)
+    ok = ok && fwrite(padding, sizeof(int32_t), 1, f) == 1;
+  offset = sizeof(profileCacheHeader) + header.namesSize + GET_WEIGHTS_SIZE(&header);
+  if(getBitVectorsOffset(&header) != offset)
+    ok = ok && fwrite(padding, getBitVectorsOffset(&header) - offset, 1, f) == 1;
+
+  FOR_0_LIMIT(i, header.length)
+    ok = ok && fwrite(GET_PROFILE_ELEM(bipartitionProfile, i)->bitVector, sizeof(BitVector), header.bitVectorLength, f) == header.bitVectorLength;
+  treeVector = CALLOC(header.treeVectorLength, sizeof(BitVector));
+  FOR_0_LIMIT(i, header.length)
+    {
+      treeSetToBitVector(&GET_PROFILE_ELEM(bipartitionProfile, i)->treeSet, treeVector, GET_BITVECTOR_LENGTH(header.numberOfTreeColumns));
+      ok = ok && fwrite(treeVector, sizeof(BitVector), header.treeVectorLength, f) == header.treeVectorLength;
+    }
+  free(treeVector);
+
+  vectorBytes = (uint64_t)header.length * (header.bitVectorLength + header.treeVectorLength) * sizeof(BitVector);
+  if(ALIGN_TO_8(vectorBytes) != vectorBytes)
+    ok = ok && fwrite(padding, ALIGN_TO_8(vectorBytes) - vectorBytes, 1, f) == 1;
+
+  FOR_0_LIMIT(i, header.length)
+    {
+      char
+        flag = GET_PROFILE_ELEM(bipartitionProfile, i)->isInMLTree ? 1 : 0;
+      ok = ok && fputc(flag, f) != EOF;
+    }
+
+  ok = (fclose(f) == 0) && ok;
+
+  if(NOT ok || rename(tmpName, fileName))
+    remove(tmpName);
+}
@@ -0,0 +1,76 @@
+/*  RogueNaRok is an algorithm for the identification of rogue taxa in a set of phylogenetic trees.
+ *
+ *  Moreover, the program collection comes with efficient implementations of
+ *   * the unrooted leaf stability by Thorley and Wilkinson
+ *   * the taxonomic instability index by Maddinson and Maddison
+ *   * a maximum agreement subtree implementation (MAST) for unrooted trees
+ *   * a tool for pruning taxa from a tree collection.
+ *
+ *  Copyright October 2011 by Andre J. Aberer
+ *
+ *  Tree I/O and parallel framework are derived from RAxML by Alexandros Stamatakis.
+ *
+ *  This program is free software; you may redistribute it and/or
+ *  modify its under the terms of the GNU General Public License as
+ *  published by the Free Software Foundation; either version 2 of the
+ *  License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  For any other inquiries send an Email to Andre J. Aberer
+ *  andre.aberer at googlemail.com
+ *
+ *  When publishing work that is based on the results from RogueNaRok, please cite:
+ *  Andre J. Aberer, Denis Krompaß, Alexandros Stamatakis. RogueNaRok: an Efficient and Exact Algorithm for Rogue Taxon Identification. (unpublished) 2011.
+ *
+ */
+
+#ifndef PROFILECACHE_H
+#define PROFILECACHE_H
+
+#include "common.h"
+#include "legacy.h"
+#include "Tree.h"
+#include "Array.h"
+#include "ProfileElem.h"
+
+#define PROFILE_CACHE_MAGIC "RNRPROF"
+#define PROFILE_CACHE_VERSION 3
+
+/*
+   Layout of a profile cache (all sections are 8-byte aligned, the
+   bit vectors start at a multiple of 64 bytes, s.t. the file can be
+   used right from a mapping):
+
+   profileCacheHeader
+   taxon names 1..mxtips, each terminated by '\0' (namesSize bytes)
+   treeWeights (numberOfTreeColumns int32, padded to 8 bytes)
+   bitVectors  (length * bitVectorLength  words, of the kernel width)
+   treeVectors (length * treeVectorLength words, without the ML bit)
+   isInMLTree  (length bytes)
+*/
+typedef struct
+{
+  char magic[8];
+  uint32_t version;
+  uint32_t byteOrder;
+  uint64_t sourceHash;          /* of the bootstrap trees and the best tree */
+  uint32_t mxtips;
+  uint32_t numberOfTrees;
+  uint32_t numberOfTreeColumns;
+  uint32_t hasBestTree;
+  uint32_t length;
+  uint32_t bitVectorLength;
+  uint32_t treeVectorLength;
+  uint32_t padding;
+  uint64_t namesSize;
+} profileCacheHeader;
+
+uint64_t hashTreeSources(TreeFile *bootstrapTrees, TreeFile *bestTree);
+Array *loadProfileCache(All *tr, const char *fileName, uint64_t sourceHash, boolean hasBestTree);
+void writeProfileCache(All *tr, Array *bipartitionProfile, const char *fileName, uint64_t sourceHash, boolean hasBestTree);
+
+#endif
@@ -42,11 +42,67 @@ void addElemToArray(ProfileElem *elem, Array *array)
 }
 
 
-void freeProfileElem(ProfileElem *elem)
+/* the store takes over bitVectors (length rows of bitVectorLength
+   words) and slab, the allocation they are in, if given */
+BipartitionStore *createBipartitionStore(uint32_t length, uint32_t bitVectorLength, BitVector *bitVectors, void *slab)
 {
-  free(elem->treeVector);
-  free(elem->bitVector);
-  free(elem);
+  BipartitionStore
+    *result = CALLOC(1, sizeof(BipartitionStore));
+
+  uint32_t
+    i;
+
+  result->length = length;
+  result->bitVectorLength = bitVectorLength;
+  result->signatureLength = getSignatureLength(bitVectorLength);
+  result->elems = CALLOC(MAX(length, 1), sizeof(ProfileElem));
+  if(bitVectors)
+    {
+      result->bitVectors = bitVectors;
+      result->slab = slab;
+    }
+  else
+    {
+      size_t
+        size = MAX((size_t)length * bitVectorLength, 1) * sizeof(BitVector);
+
+      result->bitVectors = reallocAlignedRows(&result->slab, NULL, 0, size);
+      memset(result->bitVectors, 0, size);
+    }
+  assert((uintptr_t)result->bitVectors % ROW_ALIGNMENT == 0);
+  result->signatures = CALLOC(MAX((size_t)length * result->signatureLength, 1), sizeof(uint8_t));
+
+  FOR_0_LIMIT(i, length)
+    {
+      ProfileElem
+        *elem = result->elems + i;
+
+      elem->bitVector = result->bitVectors + (size_t)i * bitVectorLength;
+      elem->signature = result->signatures + (size_t)i * result->signatureLength;
+      elem->id = i;
+    }
+
+  return result;
+}
+
+
+void freeBipartitionStore(BipartitionStore *store)
+{
+  uint32_t
+    i;
+
+  FOR_0_LIMIT(i, store->length)
+    freeTreeSet(&store->elems[i].treeSet);
+
+  free(store->elems);
+#ifndef WIN32
+  if(store->mappedSize)
+    munmap(store->slab, store->mappedSize);
+  else
+#endif
+    free(store->slab);
+  free(store->signatures);
+  free(store);
 }
 
 Array* profileToArray(HashTable *profile, boolean updateFrequencyCount, boolean assignIds)
@@ -85,13 +141,13 @@ Array* profileToArray(HashTable *profile, boolean updateFrequencyCount, boolean
       assert(profileElem);
 
       if(updateFrequencyCount)
-	profileElem->treeVectorSupport = genericBitCount(profileElem->treeVector, profileElemAttr->treeVectorLength);
+	profileElem->treeVectorSupport = weightedTreeSetSize(&profileElem->treeSet, profileElemAttr->treeVectorLength, NULL);
 
       if(assignIds)
 	profileElem->id = count;
 
       ((ProfileElem**)result->arrayTable)[count] = profileElem;
-      assert(profileElem->bitVector && profileElem->treeVector);
+      assert(profileElem->bitVector);
       count++;
     }
   while(hashTableIteratorNext(hashTableIterator));
@@ -134,19 +190,6 @@ int sortById(const void *a, const void *b)
 }
 
 
-int sortBySupport(const void *a, const void *b)
-{
-  const uint32_t
-    as = (*(ProfileElem**)a)->treeVectorSupport,
-    bs = (*(ProfileElem**)b)->treeVectorSupport;
-
-  if(as == bs)
-    return 0;
-
-  return as > bs ? -1 : 1;
-}
-
-
 /* what is the index in the (ordered) profile of the first element to
    have at least i bits set?  */
 int *createNumBitIndex(Array *bipartitionProfile, int mxtips)
@@ -38,35 +38,56 @@
 #include "HashTable.h"
 #include "common.h"
 #include "BitVector.h"
-
-
-typedef struct 
-{
-  BitVector bitVectorLength; 
-  BitVector treeVectorLength;  
-  BitVector *randForTaxa;	/* random numbers to hash the vectors */
-  BitVector lastByte;		/* the padding bits */
-} ProfileElemAttr;
+#include "TreeSet.h"
 
 
 typedef struct profile_elem
 {
   BitVector *bitVector;
-  BitVector *treeVector;
+  TreeSet treeSet;
   int treeVectorSupport;
   boolean isInMLTree;
   BitVector id;
   int numberOfBitsSet;
+  uint64_t fingerprint;         /* XOR of the taxon keys of bitVector */
+  uint8_t *signature;           /* bits set per 64-bit lane of bitVector */
 } ProfileElem;
 
+
+/* owns the bipartitions of a profile: the elements are an array
+   indexed by id and their taxon vectors are rows of a slab (with a
+   fixed stride, starting at a cache line), s.t. sweeps over all
+   bipartitions are linear in memory. The tree sets of the elements
+   are owned, too. */
+typedef struct
+{
+  uint32_t length;
+  uint32_t bitVectorLength;
+  uint32_t signatureLength;
+  ProfileElem *elems;
+  BitVector *bitVectors;
+  uint8_t *signatures;
+  void *slab;                   /* the block that holds the rows */
+  size_t mappedSize;            /* of slab, if it maps a profile cache */
+} BipartitionStore;
+
+
+typedef struct 
+{
+  BitVector bitVectorLength; 
+  BitVector treeVectorLength;  
+  BitVector lastByte;		/* the padding bits */
+  BipartitionStore *store;
+} ProfileElemAttr;
+
 #define GET_PROFILE_ELEM(array,index) (((ProfileElem**)array->arrayTable)[(index)])
 #define GET_DROPSET_ELEM(array,index) (((Dropset**)array->arrayTable)[(index)])
 
 int *createNumBitIndex(Array *bipartitionProfile, int mxtips);
 int sortById(const void *a, const void *b);
-int sortBySupport(const void *a, const void *b);
 int sortBipProfile(const void *a, const void *b);
 Array *cloneProfileArrayFlat(const Array *array);
 void addElemToArray(ProfileElem *elem, Array *array);
-void freeProfileElem(ProfileElem *elem);
+BipartitionStore *createBipartitionStore(uint32_t length, uint32_t bitVectorLength, BitVector *bitVectors, void *slab);
+void freeBipartitionStore(BipartitionStore *store);
 #endif
@@ -43,7 +43,9 @@
 #include "Dropset.h"
 #include "legacy.h"
 #include "newFunctions.h"
+#include "ProfileCache.h"
 #include "Node.h"
+#include "CandidateIndex.h"
 
 #ifdef PARALLEL
 #include "parallel.h"
@@ -67,8 +69,6 @@
 #define ML_TREE_OPT 1
 #define MRE_CONSENSUS_OPT 2
 
-#define HASH_TABLE_SIZE_CONST 100
-
 extern uint32_t *randForTaxa;
 
 int bitVectorLength,
@@ -85,7 +85,8 @@ int bitVectorLength,
   bestCumEver = 0,
 
   numBips,
-  mxtips;
+  mxtips,
+  *treeWeights = NULL;
 
 Dropset **dropsetPerRound;
 
@@ -95,6 +96,12 @@ BitVector *droppedTaxa,
   *neglectThose,
   *paddingBits;
 
+/* XOR of the keys of the taxa that have not been dropped */
+uint64_t remainingFingerprint = 0;
+
+/* fingerprint index of the profile in the current round (if any) */
+CandidateIndex *candidateIndex = NULL;
+
 double labelPenalty = 0.,
   timeInc;
 
@@ -117,12 +124,12 @@ void debug_dropsetConsistencyCheck(HashTable *mergingHash)
           if(ds == ds2)
             continue;
 
-          if(indexListEqual(ds->taxaToDrop, ds2->taxaToDrop))
+          if(taxonSetEqual(&ds->taxaToDrop, &ds2->taxaToDrop))
             {
               PR("duplicate dropset: ");
-              printIndexList(ds->taxaToDrop);
+              printTaxonSet(&ds->taxaToDrop);
               PR(" and ");
-              printIndexList(ds2->taxaToDrop);
+              printTaxonSet(&ds2->taxaToDrop);
               PR("\n");
               exit(-1);
             }
@@ -136,34 +143,7 @@ void debug_dropsetConsistencyCheck(HashTable *mergingHash)
 
 boolean isCompatible(ProfileElem* elemA, ProfileElem* elemB, BitVector *droppedTaxa)
 {
-  uint32_t i;
-
-  uint32_t
-    *A = elemA->bitVector,
-    *C = elemB->bitVector;
-
-  FOR_0_LIMIT(i,bitVectorLength)
-    if(A[i] & C[i]  & ~ (droppedTaxa[i] | paddingBits[i]) )
-      break;
-
-  if(i == bitVectorLength)
-    return TRUE;
-
-  FOR_0_LIMIT(i,bitVectorLength)
-    if( ( A[i] & ~C[i]  ) & ~ (droppedTaxa[i] | paddingBits[i]) )
-      break;
-
-  if(i == bitVectorLength)
-    return TRUE;
-
-  FOR_0_LIMIT(i,bitVectorLength)
-    if( ( ~A[i] & C[i] )  & ~ (droppedTaxa[i] | paddingBits[i]) )
-      break;
-
-  if(i == bitVectorLength)
-    return TRUE;
-  else
-    return FALSE;
+  return compatibleBitVectors(elemA->bitVector, elemB->bitVector, droppedTaxa, paddingBits, bitVectorLength);
 }
 
 
@@ -216,17 +196,13 @@ void debug_mergingHashSanityCheck(HashTable *mergingHash, int totalNumberOfBips)
 
 boolean myBitVectorEqual(ProfileElem *elemA, ProfileElem *elemB)
 {
-  boolean normalEqual = TRUE,
-    complement = TRUE;
-
-  int i ;
-  FOR_0_LIMIT(i,bitVectorLength)
-    {
-      normalEqual = normalEqual && (  elemA->bitVector[i] == elemB->bitVector[i]);
-      complement  =  complement && (elemA->bitVector[i] == ~(elemB->bitVector[i] | droppedTaxa[i] | paddingBits[i]));
-    }
+  if(elemA->fingerprint != elemB->fingerprint
+     && elemA->fingerprint != (elemB->fingerprint ^ remainingFingerprint))
+    return FALSE;
 
-  return normalEqual || complement;
+  /* the bits of dropped taxa are unset in both vectors */
+  return xorBitCount(elemA->bitVector, elemB->bitVector, bitVectorLength, 0) == 0
+    || xnorBitCount(elemA->bitVector, elemB->bitVector, droppedTaxa, paddingBits, bitVectorLength, 0) == 0;
 }
 
 
@@ -238,86 +214,72 @@ boolean canMergeWithComplement(ProfileElem *elem)
 
 boolean bitVectorEqual(ProfileElem *elemA, ProfileElem *elemB)
 {
-  boolean normalEqual = TRUE,
-    complement = TRUE;
-
-  int i ;
-  FOR_0_LIMIT(i,bitVectorLength)
-    {
-      normalEqual = normalEqual && (  elemA->bitVector[i] == elemB->bitVector[i]);
-      complement  =  complement && (elemA->bitVector[i] == ~(elemB->bitVector[i] | droppedTaxa[i] | paddingBits[i]));
-    }
+  if(elemA->fingerprint != elemB->fingerprint
+     && elemA->fingerprint != (elemB->fingerprint ^ remainingFingerprint))
+    return FALSE;
 
-  return normalEqual || complement;
+  /* the bits of dropped taxa are unset in both vectors */
+  return xorBitCount(elemA->bitVector, elemB->bitVector, bitVectorLength, 0) == 0
+    || xnorBitCount(elemA->bitVector, elemB->bitVector, droppedTaxa, paddingBits, bitVectorLength, 0) == 0;
 }
 
 
-boolean mergedBipVanishes(MergingEvent *me, Array *bipartitionsById, IndexList *taxaToDrop)
+boolean mergedBipVanishes(MergingEvent *me, Array *bipartitionsById, Dropset *dropset)
 {
-  int vanBits = 0;
+  int vanBits = 0,
+    i;
 
-  IndexList
-    *iter = taxaToDrop;
+  const TaxonSet
+    *taxaToDrop = &dropset->taxaToDrop;
 
   ProfileElem
-    *elem = me->isComplex ? GET_PROFILE_ELEM(bipartitionsById, (me->mergingBipartitions).many->index)  : GET_PROFILE_ELEM(bipartitionsById, (me->mergingBipartitions).pair[0]);
+    *elem = GET_PROFILE_ELEM(bipartitionsById, GET_FIRST_BIP(dropset, me));
 
-  FOR_LIST(iter)
-    if(NTH_BIT_IS_SET(elem->bitVector,iter->index))
+  FOR_0_LIMIT(i, taxaToDrop->numberOfTaxa)
+    if(NTH_BIT_IS_SET(elem->bitVector, GET_TAXA(taxaToDrop)[i]))
       vanBits++;
 
   return elem->numberOfBitsSet - vanBits < 2;
 }
 
 
-/* insert dropset. If it is a multi-taxa dropset, gather all merging
-   events of sub-dropsets */
-Dropset *insertOrFindDropset(HashTable *hashtable, Dropset *dropset, uint32_t hashValue)
+/* finds the dropset of the taxa of key (that only needs them) or
+   inserts a new one. The taxa of key are taken over or released. */
+Dropset *insertOrFindDropset(HashTable *hashtable, Dropset *key, uint32_t hashValue)
 {
-  void
-    *result = searchHashTable(hashtable, dropset, hashValue);
+  Dropset
+    *result = searchHashTable(hashtable, key, hashValue);
 
-  if(result)
+  if( NOT result)
     {
-      freeDropsetDeep(dropset, TRUE);
-      return result;
+      result = allocDropset();
+      result->taxaToDrop = key->taxaToDrop;
+      insertIntoHashTable(hashtable, result, hashValue);
     }
   else
-    {
-      insertIntoHashTable(hashtable, dropset, hashValue);
-      return dropset;
-    }
+    freeTaxonSet(&key->taxaToDrop);
+
+  return result;
 }
 
 boolean checkForMergerAndAddEvent(boolean complement, ProfileElem *elemA,
-                                  ProfileElem *elemB, HashTable *mergingHash)
+                                  ProfileElem *elemB, int numBit, HashTable *mergingHash)
 {
-  IndexList
-    *dropsetTaxa = getDropset(elemA,elemB,complement, neglectThose);
+  Dropset
+    key,
+    *dropset;
 
-  if(dropsetTaxa)
+  if(getDropsetTaxa(elemA, elemB, complement, numBit, neglectThose, &key.taxaToDrop))
     {
-      Dropset
-        *dropset,
-        *tmp = CALLOC(1,sizeof(Dropset));
-      tmp->taxaToDrop = dropsetTaxa;
-
-      uint32_t hashValue = 0;
-      IndexList *iter =  dropsetTaxa;
-      FOR_LIST(iter)
-      {
-        assert(iter->index < mxtips);
-        hashValue ^= randForTaxa[ iter->index ];
-      }
+      uint32_t hashValue = taxonSetHashValue(&key.taxaToDrop);
 
 #ifdef PARALLEL
-      int position  = hashValue % mergingHash->tableSize;
-      pthread_mutex_lock(mergingHash->lockPerSlot[position]);
+      pthread_mutex_lock(mergingHash->lock);
 #endif
-      dropset = insertOrFindDropset(mergingHash, tmp, hashValue);
+      dropset = insertOrFindDropset(mergingHash, &key, hashValue);
       addEventToDropsetPrime(dropset, elemA->id, elemB->id);
 #ifdef PARALLEL
-      pthread_mutex_unlock(mergingHash->lockPerSlot[position]);
+      pthread_mutex_unlock(mergingHash->lock);
 #endif
       return TRUE;
     }
@@ -334,51 +296,149 @@ boolean bothDropsetsRelevant(int numBits)
 }
 
 
-int cleanup_applyOneMergerEvent(MergingEvent *mergingEvent,
+int cleanup_applyOneMergerEvent(Dropset *dropset, MergingEvent *mergingEvent,
                                 Array *bipartitionsById,
                                 BitVector *mergingBipartitions)
 {
-  int
-    j;
-
   ProfileElem
     *resultBip, *elem;
 
-  resultBip =
-    mergingEvent->isComplex
-    ? GET_PROFILE_ELEM(bipartitionsById, mergingEvent->mergingBipartitions.many->index)
-    : GET_PROFILE_ELEM(bipartitionsById, mergingEvent->mergingBipartitions.pair[0]);
+  resultBip = GET_PROFILE_ELEM(bipartitionsById, GET_FIRST_BIP(dropset, mergingEvent));
 
   if(mergingEvent->isComplex)
     {
-        IndexList
-          *iterBip = mergingEvent->mergingBipartitions.many->next;
-        FOR_LIST(iterBip)
+      int
+        i,
+        *bips = GET_COMPLEX_BIPS(dropset, mergingEvent);
+
+      for(i = 1; i < mergingEvent->mergingBipartitions.many.length; i++)
         {
-          elem = GET_PROFILE_ELEM(bipartitionsById, iterBip->index);
+          elem = GET_PROFILE_ELEM(bipartitionsById, bips[i]);
           FLIP_NTH_BIT(mergingBipartitions, elem->id);
           resultBip->isInMLTree |= elem->isInMLTree;
-          FOR_0_LIMIT(j,treeVectorLength)
-            resultBip->treeVector[j] |= elem->treeVector[j];
+          unionTreeSet(&resultBip->treeSet, &elem->treeSet, treeVectorLength);
         }
-
-        freeIndexList(mergingEvent->mergingBipartitions.many);
-        free(mergingEvent);
     }
   else
     {
       elem = GET_PROFILE_ELEM(bipartitionsById,mergingEvent->mergingBipartitions.pair[1]);
       FLIP_NTH_BIT(mergingBipartitions, elem->id);
       resultBip->isInMLTree |= elem->isInMLTree;
-      FOR_0_LIMIT(j,treeVectorLength)
-        resultBip->treeVector[j] |=  elem->treeVector[j];
+      unionTreeSet(&resultBip->treeSet, &elem->treeSet, treeVectorLength);
     }
 
-  resultBip->treeVectorSupport = genericBitCount(resultBip->treeVector, treeVectorLength);
+  resultBip->treeVectorSupport = weightedTreeSetSize(&resultBip->treeSet, treeVectorLength, treeWeights);
   return resultBip->id;
 }
 
 
+/* the order of the bipartitions for the MRE consensus. Bipartitions of
+   equal support are ordered by their splits, s.t. the consensus does
+   not depend on the order of the profile (the order of the splits in
+   the input or in the split table). A split is compared on the taxa
+   that are left, as the side without the first of them; thus neither
+   dropped taxa nor the representation of the vector matter. */
+typedef struct
+{
+  const BitVector *taxaLeft;
+  int firstTaxonLeft;
+  int length;
+} MREOrder;
+
+
+static boolean precedesInMRE(const ProfileElem *elemA, const ProfileElem *elemB, const MREOrder *order)
+{
+  BitVector
+    flipA = NTH_BIT_IS_SET(elemA->bitVector, order->firstTaxonLeft) ? ~(BitVector)0 : 0,
+    flipB = NTH_BIT_IS_SET(elemB->bitVector, order->firstTaxonLeft) ? ~(BitVector)0 : 0;
+
+  int
+    i;
+
+  if(elemA->treeVectorSupport != elemB->treeVectorSupport)
+    return elemA->treeVectorSupport > elemB->treeVectorSupport;
+
+  FOR_0_LIMIT(i, order->length)
+    {
+      BitVector
+        wordA = (elemA->bitVector[i] ^ flipA) & order->taxaLeft[i],
+        wordB = (elemB->bitVector[i] ^ flipB) & order->taxaLeft[i];
+
+      if(wordA != wordB)
+        return wordA < wordB;
+    }
+
+  return FALSE;
+}
+
+
+/* sorts the profile for the MRE consensus on the taxa that are not in
+   taxaDropped. This is a merge sort, as qsort cannot be given the
+   order. */
+static void sortProfileForMRE(Array *bipartitionProfile, const BitVector *taxaDropped)
+{
+  int
+    i,
+    width,
+    start,
+    length = bipartitionProfile->length;
+
+  BitVector
+    *taxaLeft = CALLOC(bitVectorLength, sizeof(BitVector));
+
+  ProfileElem
+    **elems = (ProfileElem**)bipartitionProfile->arrayTable,
+    **buffer = CALLOC(MAX(length, 1), sizeof(ProfileElem*)),
+    **from = elems,
+    **to = buffer;
+
+  MREOrder
+    order;
+
+  FOR_0_LIMIT(i, bitVectorLength)
+    taxaLeft[i] = ~ (taxaDropped[i] | paddingBits[i]);
+
+  order.taxaLeft = taxaLeft;
+  order.length = bitVectorLength;
+  for(order.firstTaxonLeft = 0;
+      order.firstTaxonLeft < mxtips - 1 && NOT NTH_BIT_IS_SET(taxaLeft, order.firstTaxonLeft);
+      ++order.firstTaxonLeft);
+
+  for(width = 1; width < length; width *= 2)
+    {
+      ProfileElem
+        **swap;
+
+      for(start = 0; start < length; start += 2 * width)
+        {
+          int
+            left = start,
+            middle = MIN(start + width, length),
+            right = middle,
+            end = MIN(start + 2 * width, length),
+            k = start;
+
+          while(left < middle && right < end)
+            to[k++] = precedesInMRE(from[right], from[left], &order) ? from[right++] : from[left++];
+          while(left < middle)
+            to[k++] = from[left++];
+          while(right < end)
+            to[k++] = from[right++];
+        }
+
+      swap = from;
+      from = to;
+      to = swap;
+    }
+
+  if(from != elems)
+    memcpy(elems, from, length * sizeof(ProfileElem*));
+
+  free(buffer);
+  free(taxaLeft);
+}
+
+
 int getSupportOfMRETreeHelper(Array *bipartitionProfile, Dropset *dropset)
 {
   int
@@ -389,15 +449,10 @@ int getSupportOfMRETreeHelper(Array *bipartitionProfile, Dropset *dropset)
     *taxaDroppedHere = copyBitVector(droppedTaxa, bitVectorLength);
 
   if(dropset)
-    {
-      IndexList
-        *iter = dropset->taxaToDrop;
-      FOR_LIST(iter)
-        FLIP_NTH_BIT(taxaDroppedHere, iter->index);
-    }
+    FOR_0_LIMIT(i, dropset->taxaToDrop.numberOfTaxa)
+      FLIP_NTH_BIT(taxaDroppedHere, GET_TAXA(&dropset->taxaToDrop)[i]);
 
-  qsort(bipartitionProfile->arrayTable, bipartitionProfile->length,
-        sizeof(ProfileElem**), sortBySupport);
+  sortProfileForMRE(bipartitionProfile, taxaDroppedHere);
 
   Array *mreBips = createArray(mxtips - 3, sizeof(ProfileElem*));
 
@@ -451,46 +506,65 @@ int getSupportOfMRETreeHelper(Array *bipartitionProfile, Dropset *dropset)
 
 #define GAIN_SUPPORT me->supportGained = computeSupport ? newSup : 1
 
-void getSupportGainedThreshold(MergingEvent *me, Array *bipartitionsById)
+/* the cursors of the sets merged by an event are kept for the whole
+   run and only grow with the largest event */
+TreeSetCursor *unionCursors = NULL;
+int unionCursorsLength = 0;
+
+static TreeSetCursor *getUnionCursors(int numberOfSets)
+{
+#ifdef PARALLEL
+  /* the threads evaluate events concurrently */
+  return CALLOC(numberOfSets, sizeof(TreeSetCursor));
+#else
+  if(numberOfSets > unionCursorsLength)
+    {
+      unionCursorsLength = MAX(numberOfSets, 2 * unionCursorsLength);
+      free(unionCursors);
+      unionCursors = CALLOC(unionCursorsLength, sizeof(TreeSetCursor));
+    }
+  return unionCursors;
+#endif
+}
+
+void getSupportGainedThreshold(Dropset *dropset, MergingEvent *me, Array *bipartitionsById)
 {
   int
-    i;
+    numberOfSets = 0,
+    bestPossible = 0,
+    lowerLimit = -1,
+    upperLimit = INT_MAX,
+    newSup = 0;
   me->supportGained = 0;
-  BitVector
-    *tmp;
+  TreeSetCursor
+    *cursors;
   boolean isInMLTree = FALSE;
 
   if(me->isComplex)
     {
-      IndexList
-        *iI = me->mergingBipartitions.many;
+      int
+        i,
+        *bips = GET_COMPLEX_BIPS(dropset, me);
 
-      int bestPossible = 0;
-      FOR_LIST(iI)
-      {
-        ProfileElem
-          *elem = GET_PROFILE_ELEM(bipartitionsById, iI->index);
-        bestPossible += elem->treeVectorSupport;
-        isInMLTree |= elem->isInMLTree;
-      }
+      numberOfSets = me->mergingBipartitions.many.length;
+
+      FOR_0_LIMIT(i, numberOfSets)
+        {
+          ProfileElem
+            *elem = GET_PROFILE_ELEM(bipartitionsById, bips[i]);
+          bestPossible += elem->treeVectorSupport;
+          isInMLTree |= elem->isInMLTree;
+        }
 
       if(rogueMode == VANILLA_CONSENSUS_OPT && bestPossible < thresh)
         return ;
       if(rogueMode == ML_TREE_OPT && NOT isInMLTree)
         return ;
 
-      tmp = CALLOC(treeVectorLength, sizeof(BitVector));
+      cursors = getUnionCursors(numberOfSets);
 
-      /* create new bip vector */
-      iI = me->mergingBipartitions.many;
-      FOR_LIST(iI)
-      {
-        ProfileElem
-          *elem = GET_PROFILE_ELEM(bipartitionsById, iI->index);
-
-        FOR_0_LIMIT(i, treeVectorLength)
-          tmp[i] |= elem->treeVector[i];
-      }
+      FOR_0_LIMIT(i, numberOfSets)
+        cursors[i].set = &GET_PROFILE_ELEM(bipartitionsById, bips[i])->treeSet;
     }
   else
     {
@@ -498,20 +572,37 @@ void getSupportGainedThreshold(MergingEvent *me, Array *bipartitionsById)
         *elemA = GET_PROFILE_ELEM(bipartitionsById, me->mergingBipartitions.pair[0]),
         *elemB = GET_PROFILE_ELEM(bipartitionsById, me->mergingBipartitions.pair[1]);
 
-      if(rogueMode == VANILLA_CONSENSUS_OPT &&
-         elemA->treeVectorSupport + elemB->treeVectorSupport < thresh)
+      bestPossible = elemA->treeVectorSupport + elemB->treeVectorSupport;
+      if(rogueMode == VANILLA_CONSENSUS_OPT && bestPossible < thresh)
               return;
 
       isInMLTree = elemA->isInMLTree || elemB->isInMLTree;
       if(rogueMode == ML_TREE_OPT && NOT isInMLTree)
         return;
 
-      tmp = CALLOC(treeVectorLength, sizeof(BitVector));
-      FOR_0_LIMIT(i,treeVectorLength)
-        tmp[i] = elemA->treeVector[i] | elemB->treeVector[i];
+      cursors = getUnionCursors(2);
+      cursors[0].set = &elemA->treeSet;
+      cursors[1].set = &elemB->treeSet;
+      numberOfSets = 2;
+    }
+
+  /* the size of the union only matters beyond the threshold and, if
+     support is not counted, only whether it exceeds it */
+  if(rogueMode == VANILLA_CONSENSUS_OPT)
+    {
+      lowerLimit = thresh;
+      if(NOT computeSupport)
+        upperLimit = thresh;
     }
 
-  int newSup = genericBitCount(tmp, treeVectorLength);
+  if(computeSupport || rogueMode == VANILLA_CONSENSUS_OPT)
+    newSup = boundedUnionSize(cursors, numberOfSets, treeVectorLength, treeWeights,
+                              bestPossible, lowerLimit, upperLimit);
+
+#ifdef PARALLEL
+  free(cursors);
+#endif
+
   switch (rogueMode)
     {
     case MRE_CONSENSUS_OPT:
@@ -531,29 +622,42 @@ void getSupportGainedThreshold(MergingEvent *me, Array *bipartitionsById)
     default:
       assert(0);
     }
-
-  free(tmp);
 }
 
 
-int getSupportOfMRETree(Array *bipartitionsById,  Dropset *dropset)
+/* the emerged bipartition of an event (elem) replaces its merging
+   ones in the array */
+static ProfileElem *emergeBipartition(Dropset *dropset, MergingEvent *me, Array *bipartitionsById, Array *tmpArray, ProfileElem *elem)
 {
-  List
-    *mergingEvents = NULL;
-  if(dropset)
+  ProfileElem
+    *first = GET_PROFILE_ELEM(bipartitionsById, GET_FIRST_BIP(dropset, me));
+
+  if(me->isComplex)
     {
-      if(maxDropsetSize == 1)
-        mergingEvents =  dropset->ownPrimeE;
-      else
-        {
-          List *iter = dropset->acquiredPrimeE ;
-          FOR_LIST(iter)
-            APPEND(iter->value, mergingEvents);
-          iter = dropset->complexEvents;
-          FOR_LIST(iter)
-            APPEND(iter->value, mergingEvents);
-        }
+      int
+        i,
+        *bips = GET_COMPLEX_BIPS(dropset, me);
+
+      FOR_0_LIMIT(i, me->mergingBipartitions.many.length)
+        GET_PROFILE_ELEM(tmpArray, bips[i]) = NULL;
     }
+  else
+    {
+      GET_PROFILE_ELEM(tmpArray, me->mergingBipartitions.pair[0]) = NULL;
+      GET_PROFILE_ELEM(tmpArray, me->mergingBipartitions.pair[1]) = NULL;
+    }
+
+  getSupportGainedThreshold(dropset, me, bipartitionsById);
+  elem->treeVectorSupport = me->supportGained;
+  elem->bitVector = first->bitVector;
+  elem->fingerprint = first->fingerprint;
+
+  return elem;
+}
+
+
+int getSupportOfMRETree(Array *bipartitionsById,  Dropset *dropset)
+{
   int
     i;
 
@@ -565,46 +669,31 @@ int getSupportOfMRETree(Array *bipartitionsById,  Dropset *dropset)
       return tmp;
     }
 
+  int
+    numberOfEvents = maxDropsetSize == 1
+    ? dropset->numberOfOwnPrimeE
+    : dropset->numberOfAcquiredPrimeE + dropset->numberOfComplexEvents;
+
+  /* the emerged bips die together */
+  ProfileElem
+    *emergedElems = CALLOC(MAX(numberOfEvents, 1), sizeof(ProfileElem));
+
   Array
     *tmpArray = cloneProfileArrayFlat(bipartitionsById),
-    *emergedBips = createArray(lengthOfList(mergingEvents), sizeof(ProfileElem*)),
+    *emergedBips = createArray(numberOfEvents, sizeof(ProfileElem*)),
     *finalArray  = createArray(tmpArray->length, sizeof(ProfileElem*));
 
   /* kill merging bips from array */
-  List *meIter = mergingEvents ;
-  FOR_LIST(meIter)
-  {
-    MergingEvent *me = meIter->value;
-    if(me->isComplex)
-      {
-        IndexList *iter = me->mergingBipartitions.many;
-        FOR_LIST(iter)
-          GET_PROFILE_ELEM(tmpArray, iter->index) = NULL;
-
-        /* create emerged bips in other array */
-        ProfileElem *elem = CALLOC(1,sizeof(ProfileElem));
-        getSupportGainedThreshold(me,bipartitionsById);
-        elem->treeVectorSupport = me->supportGained;
-        elem->bitVector = GET_PROFILE_ELEM(bipartitionsById, me->mergingBipartitions.many->index)->bitVector;
-        GET_PROFILE_ELEM(emergedBips, emergedBips->length) = elem;
-        emergedBips->length++;
-      }
-    else
-      {
-        int a = me->mergingBipartitions.pair[0],
-          b = me->mergingBipartitions.pair[1];
-        GET_PROFILE_ELEM(tmpArray, a) = NULL;
-        GET_PROFILE_ELEM(tmpArray, b) = NULL;
-
-        /* create emerged bips in other array */
-        ProfileElem *elem = CALLOC(1,sizeof(ProfileElem));
-        getSupportGainedThreshold(me,bipartitionsById);
-        elem->treeVectorSupport = me->supportGained;
-        elem->bitVector = GET_PROFILE_ELEM(bipartitionsById, a)->bitVector;
-        GET_PROFILE_ELEM(emergedBips, emergedBips->length) = elem;
-        emergedBips->length++;
-      }
-  }
+  if(maxDropsetSize == 1)
+    for(i = dropset->numberOfOwnPrimeE; i--; )
+      addElemToArray(emergeBipartition(dropset, dropset->ownPrimeE + i, bipartitionsById, tmpArray, emergedElems + emergedBips->length), emergedBips);
+  else
+    {
+      FOR_0_LIMIT(i, dropset->numberOfComplexEvents)
+        addElemToArray(emergeBipartition(dropset, dropset->complexEvents + i, bipartitionsById, tmpArray, emergedElems + emergedBips->length), emergedBips);
+      FOR_0_LIMIT(i, dropset->numberOfAcquiredPrimeE)
+        addElemToArray(emergeBipartition(dropset, dropset->acquiredPrimeE[i], bipartitionsById, tmpArray, emergedElems + emergedBips->length), emergedBips);
+    }
 
   /* kill vanishing bips from array */
   FOR_0_LIMIT(i, tmpArray->length)
@@ -612,10 +701,10 @@ int getSupportOfMRETree(Array *bipartitionsById,  Dropset *dropset)
       if( GET_PROFILE_ELEM(tmpArray,i) )
         {
           ProfileElem *elem = GET_PROFILE_ELEM(tmpArray,i);
-          int remainingBits = elem->numberOfBitsSet;
-          IndexList *iter = dropset->taxaToDrop;
-          FOR_LIST(iter)
-            if(NTH_BIT_IS_SET(elem->bitVector,  iter->index))
+          int remainingBits = elem->numberOfBitsSet,
+            j;
+          FOR_0_LIMIT(j, dropset->taxaToDrop.numberOfTaxa)
+            if(NTH_BIT_IS_SET(elem->bitVector, GET_TAXA(&dropset->taxaToDrop)[j]))
               remainingBits--;
           if(remainingBits > 1)
             addElemToArray(elem, finalArray);
@@ -629,11 +718,7 @@ int getSupportOfMRETree(Array *bipartitionsById,  Dropset *dropset)
 
   int result = getSupportOfMRETreeHelper(finalArray, dropset);
 
-  if(maxDropsetSize > 1 )
-    freeListFlat(mergingEvents);
-
-  FOR_0_LIMIT(i,emergedBips->length)
-    free(GET_PROFILE_ELEM(emergedBips,i));
+  free(emergedElems);
   free(emergedBips->arrayTable);  free(emergedBips);
 
   return result;
@@ -642,11 +727,11 @@ int getSupportOfMRETree(Array *bipartitionsById,  Dropset *dropset)
 
 boolean bipartitionVanishesP(ProfileElem *elem, Dropset *dropset)
 {
-  IndexList *iter = dropset->taxaToDrop;
-  int result = elem->numberOfBitsSet;
+  int result = elem->numberOfBitsSet,
+    i;
 
-  FOR_LIST(iter)
-    if(NTH_BIT_IS_SET(elem->bitVector, iter->index))
+  FOR_0_LIMIT(i, dropset->taxaToDrop.numberOfTaxa)
+    if(NTH_BIT_IS_SET(elem->bitVector, GET_TAXA(&dropset->taxaToDrop)[i]))
       result--;
 
   return result < 2;
@@ -670,7 +755,6 @@ void removeMergedBipartitions(Array *bipartitionsById, Array *bipartitionProfile
         {
           GET_PROFILE_ELEM(bipartitionProfile, i) = NULL;
           GET_PROFILE_ELEM(bipartitionsById, elem->id) = NULL;
-          freeProfileElem(elem);
 #ifdef PRINT_VERY_VERBOSE
           PR("CLEAN UP: removing %d from bip profile because of merger\n", elem->id);
 #endif
@@ -679,48 +763,12 @@ void removeMergedBipartitions(Array *bipartitionsById, Array *bipartitionProfile
 }
 
 
-boolean eventMustBeRecomputed(MergingEvent *meIter, BitVector *mergingBipartitions, BitVector *newCandidates)
+/* own events are never complex */
+boolean checkValidityOfEvent(BitVector *obsoleteBips, MergingEvent *me)
 {
-  boolean
-    mustBeRecomputed = FALSE;
-
-  IndexList
-    *mergingBipsIter = meIter->mergingBipartitions.many;
-  FOR_LIST(mergingBipsIter)
-    mustBeRecomputed |=
-    NTH_BIT_IS_SET(mergingBipartitions,mergingBipsIter->index)
-    | NTH_BIT_IS_SET(newCandidates, mergingBipsIter->index);
-
-  return mustBeRecomputed;
-}
-
-
-boolean checkValidityOfEvent(BitVector *obsoleteBips, List *elem)
-{
-  MergingEvent
-    *me = elem->value;
-  boolean
-    killP = FALSE;
-
-  if(me->isComplex)
-    {
-      IndexList
-        *iter  = me->mergingBipartitions.many;
-      FOR_LIST(iter)
-        killP |= NTH_BIT_IS_SET(obsoleteBips, iter->index);
-      if(killP)
-              freeIndexList(me->mergingBipartitions.many);
-    }
-  else
-    killP = NTH_BIT_IS_SET(obsoleteBips, me->mergingBipartitions.pair[0]) || NTH_BIT_IS_SET(obsoleteBips, me->mergingBipartitions.pair[1]) ;
-
-  if(killP)
-    {
-      free(me);
-      return FALSE;
-    }
-  else
-    return TRUE;
+  assert(NOT me->isComplex);
+  return NOT (NTH_BIT_IS_SET(obsoleteBips, me->mergingBipartitions.pair[0])
+              || NTH_BIT_IS_SET(obsoleteBips, me->mergingBipartitions.pair[1]));
 }
 
 #ifdef MYDEBUG_NOTWORKING
@@ -787,46 +835,25 @@ void cleanup_mergingEvents(HashTable *mergingHash, BitVector *mergingBipartition
       Dropset
         *dropset = getCurrentValueFromHashTableIterator(htIter);
 
-      /* always remove combined events */
-      List *iter = dropset->complexEvents;
-      FOR_LIST(iter)
-      {
-        MergingEvent *me = iter->value;
-        assert(me);
-        if(me && me->isComplex)
-          {
-            freeIndexList(me->mergingBipartitions.many);
-            free(me);
-          }
-      }
-      freeListFlat(dropset->complexEvents);
+      int
+        j,
+        numberOfValid = 0;
 
-      /* always remove acquired elems */
-      freeListFlat(dropset->acquiredPrimeE);
-    }
-  free(htIter);
+      assert(dropset);
 
-  /* reduce own elements */
-  FOR_HASH_2(htIter, mergingHash)
-    {
-      Dropset
-        *dropset = getCurrentValueFromHashTableIterator(htIter);
+      /* always remove combined and acquired events */
+      clearCombinedEvents(dropset);
 
-      assert(dropset);
+      /* reduce own elements */
+      FOR_0_LIMIT(j, dropset->numberOfOwnPrimeE)
+        if(checkValidityOfEvent(mergingBipartitions, dropset->ownPrimeE + j))
+          dropset->ownPrimeE[numberOfValid++] = dropset->ownPrimeE[j];
 
-      /* prime events */
-      List
-        *iter = dropset->ownPrimeE,
-        *start = NULL;
-      while(iter)
+      if(numberOfValid < dropset->numberOfOwnPrimeE)
         {
-          List *next = iter->next;
-          if( checkValidityOfEvent(mergingBipartitions, iter) )
-            APPEND(iter->value, start);
-          free(iter);
-          iter = next;
+          dropset->numberOfOwnPrimeE = numberOfValid;
+          forgetPrimeBips(dropset);
         }
-      dropset->ownPrimeE = start;
     }
   free(htIter);
 
@@ -848,9 +875,8 @@ void cleanup_mergingEvents(HashTable *mergingHash, BitVector *mergingBipartition
 void unifyBipartitionRepresentation(Array *bipartitionArray,  BitVector *droppedTaxa)
 {
   int
-    i,j,
-    bvLen = GET_BITVECTOR_LENGTH(mxtips),
-    remainingTaxa = mxtips - genericBitCount(droppedTaxa, bvLen);
+    i,
+    remainingTaxa = mxtips - genericBitCount(droppedTaxa, bitVectorLength);
 
 #ifdef PRINT_VERY_VERBOSE
   PR("remaining taxa: %d\n", remainingTaxa);
@@ -869,9 +895,10 @@ void unifyBipartitionRepresentation(Array *bipartitionArray,  BitVector *dropped
 #ifdef PRINT_VERY_VERBOSE
           PR("%d (%d bits set), ", elem->id, elem->numberOfBitsSet);
 #endif
-          FOR_0_LIMIT(j,bvLen)
-            elem->bitVector[j] = ~(elem->bitVector[j] | paddingBits[j] |  droppedTaxa[j]);
+          complementBitVector(elem->bitVector, paddingBits, droppedTaxa, bitVectorLength);
           elem->numberOfBitsSet = remainingTaxa - elem->numberOfBitsSet;
+          elem->fingerprint ^= remainingFingerprint;
+          computeSignature(elem->bitVector, NULL, NULL, elem->signature, bitVectorLength);
         }
     }
 #ifdef PRINT_VERY_VERBOSE
@@ -954,24 +981,17 @@ void printDropsetImprovement(Dropset *dropset, All *tr, int cumScore)
   return ;
 #endif
 
-  IndexList
-    *iter = dropset->taxaToDrop;
-  boolean isFirst = TRUE;
+  const TaxonSet
+    *taxa = &dropset->taxaToDrop;
+  int i;
 
-  FOR_LIST(iter)
-  {
-    PR( isFirst ? ">%d" : ",%d", iter->index);
-    isFirst = FALSE;
-  }
+  /* from the largest taxon on, as in the other outputs */
+  for(i = taxa->numberOfTaxa; i--; )
+    PR(i == taxa->numberOfTaxa - 1 ? ">%d" : ",%d", GET_TAXA(taxa)[i]);
 
-  isFirst = TRUE;
   PR("\t");
-  iter = dropset->taxaToDrop;
-  FOR_LIST(iter)
-  {
-    PR(isFirst ? "%s" : ",%s" , tr->nameList[iter->index+1]);
-    isFirst = FALSE;
-  }
+  for(i = taxa->numberOfTaxa; i--; )
+    PR(i == taxa->numberOfTaxa - 1 ? "%s" : ",%s" , tr->nameList[GET_TAXA(taxa)[i]+1]);
 
   PR("\t");
   PR("%f\t%f\n",
@@ -980,20 +1000,12 @@ void printDropsetImprovement(Dropset *dropset, All *tr, int cumScore)
 }
 
 
-void fprintRogueNames(All *tr, FILE *file, IndexList *list)
+void fprintRogueNames(All *tr, FILE *file, const TaxonSet *taxa)
 {
-  boolean isFirst = TRUE;
+  int i;
 
-  FOR_LIST(list)
-  {
-    if(isFirst)
-      {
-        fprintf(file, "%s", tr->nameList[list->index+1]);
-        isFirst = FALSE;
-      }
-    else
-      fprintf(file, ",%s", tr->nameList[list->index+1]);
-  }
+  for(i = taxa->numberOfTaxa; i--; )
+    fprintf(file, i == taxa->numberOfTaxa - 1 ? "%s" : ",%s", tr->nameList[GET_TAXA(taxa)[i]+1]);
 }
 
 
@@ -1007,9 +1019,9 @@ void printRogueInformationToFile( All *tr, FILE *rogueOutput, int bestCumEver,
   while ( NOT reached)
     {
       fprintf(rogueOutput, "%d\t", i);
-      printIndexListToFile(rogueOutput, dropsetInRound[i]->taxaToDrop);
+      printTaxonSetToFile(rogueOutput, &dropsetInRound[i]->taxaToDrop);
       fprintf(rogueOutput, "\t");
-      fprintRogueNames(tr, rogueOutput, dropsetInRound[i]->taxaToDrop);
+      fprintRogueNames(tr, rogueOutput, &dropsetInRound[i]->taxaToDrop);
       fprintf(rogueOutput, "\t%f\t%f\n",
               (double)(cumScores[i]  - cumScores[i-1] )/ (double)(computeSupport ? tr->numberOfTrees : 1.0),
               (double)cumScores[i] / (double)((computeSupport ? numberOfTrees : 1 ) * (mxtips-3)) );
@@ -1026,47 +1038,174 @@ void printRogueInformationToFile( All *tr, FILE *rogueOutput, int bestCumEver,
 }
 
 
-void findCandidatesForBip(HashTable *mergingHash, ProfileElem *elemA, boolean firstMerge, Array *bipartitionsById, Array *bipartitionProfile, int* indexByNumberBits)
+/* the candidates of a bipartition are compared in blocks of this size */
+#define CANDIDATE_BLOCK_SIZE 64
+
+/* a lookup in the index costs about as much as scanning
+   CANDIDATE_INDEX_COST positions of the profile, and building it
+   CANDIDATE_INDEX_BUILD_COST per bipartition */
+#define CANDIDATE_INDEX_COST 4
+#define CANDIDATE_INDEX_BUILD_COST 16
+
+void addEventsForCandidateBlock(HashTable *mergingHash, ProfileElem *elemA, const uint8_t *complementSignature,
+                                ProfileElem **candidates, int numberOfCandidates)
 {
-  ProfileElem
-    *elemB;
-  int indexInBitSortedArray;
+  int
+    j,
+    counts[CANDIDATE_BLOCK_SIZE],
+    complementCounts[CANDIDATE_BLOCK_SIZE];
 
-  boolean
-    compMerge = canMergeWithComplement(elemA);
+  getDifferenceCounts(elemA, complementSignature, candidates, numberOfCandidates, counts, complementCounts);
 
+  FOR_0_LIMIT(j, numberOfCandidates)
+    {
+      boolean foundOne = FALSE;
+      if(complementSignature && complementCounts[j] <= maxDropsetSize)
+        foundOne = checkForMergerAndAddEvent(TRUE,elemA, candidates[j], complementCounts[j], mergingHash);
+
+      if((NOT foundOne || bothDropsetsRelevant(elemA->numberOfBitsSet)) && counts[j] <= maxDropsetSize)
+        checkForMergerAndAddEvent(FALSE, elemA, candidates[j], counts[j], mergingHash);
+    }
+}
+
+
+/* the first position in the bit sorted profile, that may hold a
+   candidate for elemA */
+int getCandidateWindowStart(ProfileElem *elemA, boolean compMerge, boolean firstMerge, int *indexByNumberBits)
+{
   if(firstMerge)
     {
       if(NOT compMerge && maxDropsetSize == 1)
-        indexInBitSortedArray = indexByNumberBits[elemA->numberOfBitsSet +1];
+        return indexByNumberBits[elemA->numberOfBitsSet +1];
       else
-        indexInBitSortedArray = indexByNumberBits[elemA->numberOfBitsSet];
+        return indexByNumberBits[elemA->numberOfBitsSet];
     }
   else
-    indexInBitSortedArray =
+    return
       elemA->numberOfBitsSet - maxDropsetSize < 0 ?
       indexByNumberBits[0]
       : indexByNumberBits[elemA->numberOfBitsSet-maxDropsetSize];
+}
+
+
+/* estimates the number of positions that are scanned for elemA */
+int getCandidateWindowSize(ProfileElem *elemA, int windowStart, Array *bipartitionProfile, int *indexByNumberBits)
+{
+  int
+    numBits = elemA->numberOfBitsSet + maxDropsetSize + 1,
+    windowEnd = numBits < mxtips ? indexByNumberBits[numBits] : (int)bipartitionProfile->length;
+
+  return MAX(windowEnd - windowStart, 0);
+}
+
+
+void findCandidatesForBip(HashTable *mergingHash, ProfileElem *elemA, boolean firstMerge, Array *bipartitionsById, Array *bipartitionProfile, int* indexByNumberBits)
+{
+  ProfileElem
+    *elemB,
+    *candidates[CANDIDATE_BLOCK_SIZE];
+  int i,
+    indexInBitSortedArray,
+    windowStart,
+    numberOfPositions = 0,
+    *positions = NULL,
+    numberOfCandidates = 0;
+
+  uint8_t
+    *complementSignature = NULL;
+
+  boolean
+    useIndex,
+    compMerge = canMergeWithComplement(elemA);
+
+  if(compMerge)
+    {
+      complementSignature = CALLOC(getSignatureLength(bitVectorLength), sizeof(uint8_t));
+      computeSignature(elemA->bitVector, droppedTaxa, paddingBits, complementSignature, bitVectorLength);
+    }
+
+  windowStart = getCandidateWindowStart(elemA, compMerge, firstMerge, indexByNumberBits);
 
-  for( ;
-       indexInBitSortedArray < bipartitionProfile->length
-         && (elemB = GET_PROFILE_ELEM(bipartitionProfile,indexInBitSortedArray))
-         && elemB->numberOfBitsSet - elemA->numberOfBitsSet <= maxDropsetSize ;
-       indexInBitSortedArray++)
+  /* only visit the neighborhood of elemA (and of its complement), if
+     this is cheaper than the window */
+  useIndex = candidateIndex
+    && CANDIDATE_INDEX_COST * candidateIndex->numberOfLookups * (compMerge ? 2 : 1)
+    < getCandidateWindowSize(elemA, windowStart, bipartitionProfile, indexByNumberBits);
+  if(useIndex)
+    numberOfPositions = getCandidates(candidateIndex, elemA->fingerprint, elemA->fingerprint ^ remainingFingerprint,
+                                      compMerge, &positions);
+
+  for(i = 0;
+      useIndex ? i < numberOfPositions : windowStart + i < (int)bipartitionProfile->length;
+      ++i)
     {
+      indexInBitSortedArray = useIndex ? positions[i] : windowStart + i;
+      if(indexInBitSortedArray < windowStart)
+        continue;
+
+      elemB = GET_PROFILE_ELEM(bipartitionProfile,indexInBitSortedArray);
+      if(NOT elemB || elemB->numberOfBitsSet - elemA->numberOfBitsSet > maxDropsetSize)
+        break;
+
       if(
          maxDropsetSize == 1 &&
          NOT compMerge &&
          elemA->numberOfBitsSet == elemB->numberOfBitsSet)
         continue;
 
-      boolean foundOne = FALSE;
-      if(compMerge)
-        foundOne = checkForMergerAndAddEvent(TRUE,elemA, elemB, mergingHash);
-
-      if(NOT foundOne || bothDropsetsRelevant(elemA->numberOfBitsSet))
-        checkForMergerAndAddEvent(FALSE, elemA, elemB, mergingHash);
+      candidates[numberOfCandidates++] = elemB;
+      if(numberOfCandidates == CANDIDATE_BLOCK_SIZE)
+        {
+          addEventsForCandidateBlock(mergingHash, elemA, complementSignature, candidates, numberOfCandidates);
+          numberOfCandidates = 0;
+        }
     }
+
+  if(numberOfCandidates)
+    addEventsForCandidateBlock(mergingHash, elemA, complementSignature, candidates, numberOfCandidates);
+
+  free(positions);
+  free(complementSignature);
+}
+
+
+/* the index pays off, if it saves scanning many more positions than
+   the profile has bipartitions */
+CandidateIndex *createCandidateIndexIfWorthwhile(Array *bipartitionProfile, Array *bipartitionsById, BitVector *candidateBips, boolean firstMerge, int *indexByNumberBits)
+{
+  int
+    i,
+    numberOfTaxa = 0;
+
+  double
+    lookups,
+    saved = 0;
+
+  FOR_0_LIMIT(i, mxtips)
+    if(NTH_BIT_IS_SET(neglectThose, i) && NOT NTH_BIT_IS_SET(droppedTaxa, i))
+      numberOfTaxa++;
+
+  lookups = CANDIDATE_INDEX_COST * getNeighborhoodSize(numberOfTaxa, maxDropsetSize);
+
+  FOR_0_LIMIT(i,bipartitionProfile->length)
+    if(NTH_BIT_IS_SET(candidateBips, i))
+      {
+        ProfileElem
+          *elemA = GET_PROFILE_ELEM(bipartitionsById, i);
+
+        boolean
+          compMerge = canMergeWithComplement(elemA);
+
+        saved += MAX(getCandidateWindowSize(elemA,
+                                            getCandidateWindowStart(elemA, compMerge, firstMerge, indexByNumberBits),
+                                            bipartitionProfile, indexByNumberBits)
+                     - lookups * (compMerge ? 2 : 1), 0);
+      }
+
+  if(saved <= (double)CANDIDATE_INDEX_BUILD_COST * bipartitionProfile->length)
+    return NULL;
+
+  return createCandidateIndex(bipartitionProfile, maxDropsetSize, neglectThose, droppedTaxa, mxtips);
 }
 
 
@@ -1084,72 +1223,60 @@ void createOrUpdateMergingHash(All *tr, HashTable *mergingHash, Array *bipartiti
 
 void combineEventsForOneDropset(Array *allDropsets, Dropset *refDropset, Array *bipartitionsById)
 {
-  List *allEventsUncombined = NULL;
-  refDropset->acquiredPrimeE = NULL;
-  refDropset->complexEvents = NULL;
+  MergingEvent
+    **allEventsUncombined;
+  Arena
+    *arena;
   int eventCntr = 0;
 
-  if(NOT refDropset->taxaToDrop->next)
+  clearCombinedEvents(refDropset);
+
+  if(refDropset->taxaToDrop.numberOfTaxa == 1)
     {
-      List *iter =  refDropset->ownPrimeE;
-      FOR_LIST(iter)
-       APPEND(iter->value, refDropset->acquiredPrimeE);
+      int j;
+      FOR_0_LIMIT(j, refDropset->numberOfOwnPrimeE)
+        addAcquiredEvent(refDropset, refDropset->ownPrimeE + j);
       return;
     }
 
   /* gather all events */
-  int i;
+  int i, j;
   FOR_0_LIMIT(i,allDropsets->length)
     {
       Dropset *currentDropset = GET_DROPSET_ELEM(allDropsets, i);
-      if( isSubsetOf(currentDropset->taxaToDrop, refDropset->taxaToDrop) )
-        {
-          List
-            *iter = currentDropset->ownPrimeE;
-          FOR_LIST(iter)
-          {
-            APPEND(iter->value, allEventsUncombined);
-            eventCntr++;
-          }
-        }
+      if( taxonSetIsSubsetOf(&currentDropset->taxaToDrop, &refDropset->taxaToDrop) )
+        eventCntr += currentDropset->numberOfOwnPrimeE;
+    }
+
+  /* the graph of the events (its nodes, edges and components) only
+     lives during the combination. The arena is large enough for all
+     of it. */
+  arena = createArena(eventCntr * (sizeof(MergingEvent*) + 2 * sizeof(Node) + 4 * sizeof(IndexList)));
+  allEventsUncombined = arenaAlloc(arena, eventCntr * sizeof(MergingEvent*));
+  eventCntr = 0;
+  FOR_0_LIMIT(i,allDropsets->length)
+    {
+      Dropset *currentDropset = GET_DROPSET_ELEM(allDropsets, i);
+      if( taxonSetIsSubsetOf(&currentDropset->taxaToDrop, &refDropset->taxaToDrop) )
+        FOR_0_LIMIT(j, currentDropset->numberOfOwnPrimeE)
+          allEventsUncombined[eventCntr++] = currentDropset->ownPrimeE + j;
     }
 
   /* transform the edges into nodes */
-  HashTable *allNodes = createHashTable(eventCntr * 10, NULL, nodeHashValue, nodeEqual);
-  Node *found;
-  List *iter = allEventsUncombined;
-  FOR_LIST(iter)
+  HashTable *allNodes = createHashTable(2 * eventCntr, NULL, nodeHashValue, nodeEqual);
+  FOR_0_LIMIT(i, eventCntr)
   {
-    MergingEvent *me = (MergingEvent*)iter->value;
+    MergingEvent *me = allEventsUncombined[i];
     int a = me->mergingBipartitions.pair[0];
     int b = me->mergingBipartitions.pair[1];
 
-
-    if( ( found = searchHashTableWithInt(allNodes, a) ) )
-      APPEND_INT(b,found->edges);
-    else
-      {
-        Node *node = CALLOC(1,sizeof(Node));
-        node->id = a;
-        APPEND_INT(b,node->edges);
-        insertIntoHashTable(allNodes, node, a);
-      }
-
-    if( ( found = searchHashTableWithInt(allNodes, b) ) )
-      APPEND_INT(a,found->edges);
-    else
-      {
-        Node *node = CALLOC(1,sizeof(Node));
-        node->id = b;
-        APPEND_INT(a,node->edges);
-        insertIntoHashTable(allNodes, node, b);
-      }
+    addEdgeToNode(allNodes, arena, a, b);
+    addEdgeToNode(allNodes, arena, b, a);
   }
 
-  iter = allEventsUncombined;
-  FOR_LIST(iter)
+  FOR_0_LIMIT(i, eventCntr)
   {
-    MergingEvent *me = (MergingEvent*)iter->value;
+    MergingEvent *me = allEventsUncombined[i];
     int a = me->mergingBipartitions.pair[0],
       b = me->mergingBipartitions.pair[1];
 
@@ -1161,24 +1288,19 @@ void combineEventsForOneDropset(Array *allDropsets, Dropset *refDropset, Array *
       {
         assert(foundA->edges->index == foundB->id );
         assert(foundB->edges->index == foundA->id );
-        APPEND(me, refDropset->acquiredPrimeE);
+        addAcquiredEvent(refDropset, me);
       }
     else
       {
         IndexList
-          *component = findAnIndependentComponent(allNodes,foundA);
+          *component = findAnIndependentComponent(allNodes, foundA, arena);
         if( component)
-          {
-            MergingEvent *complexMe  = CALLOC(1,sizeof(MergingEvent));
-            complexMe->mergingBipartitions.many = component;
-            complexMe->isComplex = TRUE;
-            APPEND(complexMe,refDropset->complexEvents);
-          }
+          addComplexEvent(refDropset, component);
       }
   }
 
-  destroyHashTable(allNodes, freeNode);
-  freeListFlat(allEventsUncombined);
+  destroyHashTable(allNodes, NULL);
+  destroyArena(arena);
 }
 
 
@@ -1218,18 +1340,20 @@ HashTable *combineMergerEvents(HashTable *mergingHash, Array *bipartitionsById)
 #define LOSE_SUPPORT(elem)                                       \
     me->supportLost += computeSupport ? (elem)->treeVectorSupport : 1
 
-void getLostSupportThreshold(MergingEvent *me, Array *bipartitionsById)
+void getLostSupportThreshold(Dropset *dropset, MergingEvent *me, Array *bipartitionsById)
 {
   ProfileElem *elemA, *elemB ;
   me->supportLost = 0;
 
   if(me->isComplex)
     {
-      IndexList *iI = me->mergingBipartitions.many;
+      int
+        i,
+        *bips = GET_COMPLEX_BIPS(dropset, me);
 
-      FOR_LIST(iI)
+      FOR_0_LIMIT(i, me->mergingBipartitions.many.length)
       {
-        elemA = GET_PROFILE_ELEM(bipartitionsById, iI->index);
+        elemA = GET_PROFILE_ELEM(bipartitionsById, bips[i]);
         switch (rogueMode)
         {
         case VANILLA_CONSENSUS_OPT:
@@ -1280,64 +1404,60 @@ void getLostSupportThreshold(MergingEvent *me, Array *bipartitionsById)
 void evaluateDropset(HashTable *mergingHash, Dropset *dropset,
                      Array *bipartitionsById, List *consensusBipsCanVanish )
 {
-  int result = 0;
-  List
-    *allElems = NULL,
-    *elemsToCheck = NULL;
-
-  if(maxDropsetSize == 1)
-    {
-      elemsToCheck = dropset->ownPrimeE ;
-    }
-  else
-    {
-      List *otherIter = dropset->acquiredPrimeE;
-      FOR_LIST(otherIter)
-        APPEND(otherIter->value, elemsToCheck);
-      otherIter = dropset->complexEvents;
-      FOR_LIST(otherIter)
-        APPEND(otherIter->value, elemsToCheck);
-      allElems = elemsToCheck;
-    }
+  int
+    result = 0,
+    i,
+    numberOfEvents = maxDropsetSize == 1
+    ? dropset->numberOfOwnPrimeE
+    : dropset->numberOfAcquiredPrimeE + dropset->numberOfComplexEvents;
 
   BitVector
     *bipsSeen = CALLOC(GET_BITVECTOR_LENGTH(bipartitionsById->length), sizeof(BitVector));
 
-  FOR_LIST(elemsToCheck)
+  FOR_0_LIMIT(i, numberOfEvents)
   {
-    MergingEvent *me = (MergingEvent*)elemsToCheck->value;
+    MergingEvent
+      *me = maxDropsetSize == 1
+      ? dropset->ownPrimeE + i
+      : (i < dropset->numberOfAcquiredPrimeE
+         ? dropset->acquiredPrimeE[i]
+         : dropset->complexEvents + (i - dropset->numberOfAcquiredPrimeE));
 
     if(NOT me->computed)
       {
-        getLostSupportThreshold(me, bipartitionsById);
-        getSupportGainedThreshold(me, bipartitionsById);
+        getLostSupportThreshold(dropset, me, bipartitionsById);
+        getSupportGainedThreshold(dropset, me, bipartitionsById);
         me->computed = TRUE;
       }
 
     result -= me->supportLost;
     if(  me->supportGained
-         &&  NOT mergedBipVanishes(me, bipartitionsById, dropset->taxaToDrop) )
+         &&  NOT mergedBipVanishes(me, bipartitionsById, dropset) )
       result += me->supportGained;
 
     if(me->isComplex)
       {
-        IndexList *iI =  me->mergingBipartitions.many ;
-        FOR_LIST(iI)
+        int
+          j,
+          *bips = GET_COMPLEX_BIPS(dropset, me);
+
+        FOR_0_LIMIT(j, me->mergingBipartitions.many.length)
         {
-          assert(NOT NTH_BIT_IS_SET(bipsSeen, iI->index));
-          if(NTH_BIT_IS_SET(bipsSeen, iI->index))
+          assert(NOT NTH_BIT_IS_SET(bipsSeen, bips[j]));
+          if(NTH_BIT_IS_SET(bipsSeen, bips[j]))
             {
               // MS: This is a fatal error.  We can't exit, so return.
               REprintf("Fatal error whilst merging bipartitions.\n");
               PR("problem:");
-              printIndexList(me->mergingBipartitions.many);
+              FOR_0_LIMIT(j, me->mergingBipartitions.many.length)
+                PR("%d,", bips[j]);
               PR("at ");
-              printIndexList(dropset->taxaToDrop);
+              printTaxonSet(&dropset->taxaToDrop);
               PR("\n");
               // exit(0);
               return;
             }
-          FLIP_NTH_BIT(bipsSeen, iI->index);
+          FLIP_NTH_BIT(bipsSeen, bips[j]);
         }
       }
     else
@@ -1348,7 +1468,6 @@ void evaluateDropset(HashTable *mergingHash, Dropset *dropset,
         FLIP_NTH_BIT(bipsSeen,me->mergingBipartitions.pair[1]);
       }
   }
-  freeListFlat(allElems);
 
 
   /* handle vanishing bip */
@@ -1434,7 +1553,7 @@ Dropset *evaluateEvents(HashTable *mergingHash, Array *bipartitionsById, Array *
   Dropset
     *result = NULL;
 
-  int i ;
+  int i;
 
   List
     *consensusBipsCanVanish = getConsensusBipsCanVanish(bipartitionProfile);
@@ -1506,8 +1625,8 @@ Dropset *evaluateEvents(HashTable *mergingHash, Array *bipartitionsById, Array *
         result = dropset;
       else
         {
-          const double drSize = lengthIndexList(dropset->taxaToDrop),
-                       resSize = lengthIndexList(result->taxaToDrop);
+          const double drSize = dropset->taxaToDrop.numberOfTaxa,
+                       resSize = result->taxaToDrop.numberOfTaxa;
 
           double oldQuality, newQuality;
           if (labelPenalty == 0.0) {
@@ -1522,7 +1641,11 @@ Dropset *evaluateEvents(HashTable *mergingHash, Array *bipartitionsById, Array *
               labelPenalty * drSize;
           }
 
-          if( (newQuality  >  oldQuality) )
+          /* of dropsets of equal quality, the one with fewer and
+             then smaller taxa is taken */
+          if( newQuality > oldQuality
+              || (newQuality == oldQuality
+                  && compareTaxonSets(&dropset->taxaToDrop, &result->taxaToDrop) < 0) )
             result = dropset;
         }
     }
@@ -1532,7 +1655,7 @@ Dropset *evaluateEvents(HashTable *mergingHash, Array *bipartitionsById, Array *
   free(allDropsets);
 
   // if((result->improvement / (computeSupport ? numberOfTrees : 1.0) -
-  //    labelPenalty * lengthIndexList(result->taxaToDrop)) > 0.0 ) {
+  //    labelPenalty * result->taxaToDrop.numberOfTaxa) > 0.0 ) {
   //   return result;
   // }
 
@@ -1542,21 +1665,25 @@ Dropset *evaluateEvents(HashTable *mergingHash, Array *bipartitionsById, Array *
     } else {
       return (double)(result->improvement /
               (computeSupport ? (double)numberOfTrees : 1.0) -
-              labelPenalty * lengthIndexList(result->taxaToDrop)) > 0.0 ?
+              labelPenalty * result->taxaToDrop.numberOfTaxa) > 0.0 ?
       result : NULL;
     }
 
 }
 
 
+/* sweeps the bipartitions in the order of their ids, which is the
+   order of the store */
 void cleanup_updateNumBitsAndCleanArrays(Array *bipartitionProfile, Array *bipartitionsById, BitVector *mergingBipartitions, BitVector *newCandidates, Dropset *dropset)
 {
-  int profileIndex;
+  int
+    id,
+    profileIndex;
 
-  FOR_0_LIMIT(profileIndex,bipartitionProfile->length)
+  FOR_0_LIMIT(id,bipartitionsById->length)
     {
       ProfileElem
-        *elem = GET_PROFILE_ELEM(bipartitionProfile,profileIndex);
+        *elem = GET_PROFILE_ELEM(bipartitionsById,id);
 
       if( NOT elem )
         continue;
@@ -1566,15 +1693,18 @@ void cleanup_updateNumBitsAndCleanArrays(Array *bipartitionProfile, Array *bipar
         {
           if( mxtips - taxaDropped - 2 * elem->numberOfBitsSet <= 2 * maxDropsetSize )
             FLIP_NTH_BIT(newCandidates, elem->id);
-          IndexList *iter = dropset->taxaToDrop;
+          int i;
           boolean taxonDroppedP = FALSE;
-          FOR_LIST(iter)
+          FOR_0_LIMIT(i, dropset->taxaToDrop.numberOfTaxa)
           {
-            if(NTH_BIT_IS_SET(elem->bitVector, iter->index))
+            int taxon = GET_TAXA(&dropset->taxaToDrop)[i];
+            if(NTH_BIT_IS_SET(elem->bitVector, taxon))
               {
                 taxonDroppedP = TRUE;
-                UNFLIP_NTH_BIT(elem->bitVector, iter->index);
+                UNFLIP_NTH_BIT(elem->bitVector, taxon);
                 elem->numberOfBitsSet--;
+                elem->fingerprint ^= taxonKey(taxon);
+                elem->signature[taxon / (2 * MASK_LENGTH)]--;
               }
           }
 
@@ -1594,11 +1724,18 @@ void cleanup_updateNumBitsAndCleanArrays(Array *bipartitionProfile, Array *bipar
       if(NTH_BIT_IS_SET(mergingBipartitions,elem->id))
         {
           assert(NOT NTH_BIT_IS_SET(newCandidates, elem->id));
-          GET_PROFILE_ELEM(bipartitionProfile, profileIndex) = NULL;
           GET_PROFILE_ELEM(bipartitionsById, elem->id) = NULL;
-          freeProfileElem(elem);
         }
     }
+
+  FOR_0_LIMIT(profileIndex,bipartitionProfile->length)
+    {
+      ProfileElem
+        *elem = GET_PROFILE_ELEM(bipartitionProfile,profileIndex);
+
+      if(elem && NTH_BIT_IS_SET(mergingBipartitions,elem->id))
+        GET_PROFILE_ELEM(bipartitionProfile, profileIndex) = NULL;
+    }
 }
 
 
@@ -1609,26 +1746,29 @@ BitVector *cleanup_applyAllMergerEvents(Array *bipartitionsById, Dropset *bestDr
 
   if( bestDropset)
     {
+      int
+        i,
+        newBipId;
 
-      List *iter = NULL ;
       if(maxDropsetSize == 1)
-        iter = bestDropset->ownPrimeE;
-      else
-        iter = bestDropset->acquiredPrimeE;
-      FOR_LIST(iter)
-      {
-        int newBipId = cleanup_applyOneMergerEvent((MergingEvent*)iter->value, bipartitionsById, mergingBipartitions);
-        FLIP_NTH_BIT(candidateBips, newBipId);
-      }
-
-      if(maxDropsetSize > 1 )
-        {
-          iter = bestDropset->complexEvents;
-          FOR_LIST(iter)
+        FOR_0_LIMIT(i, bestDropset->numberOfOwnPrimeE)
           {
-            int newBipId = cleanup_applyOneMergerEvent((MergingEvent*)iter->value, bipartitionsById, mergingBipartitions);
+            newBipId = cleanup_applyOneMergerEvent(bestDropset, bestDropset->ownPrimeE + i, bipartitionsById, mergingBipartitions);
             FLIP_NTH_BIT(candidateBips, newBipId);
           }
+      else
+        {
+          FOR_0_LIMIT(i, bestDropset->numberOfAcquiredPrimeE)
+            {
+              newBipId = cleanup_applyOneMergerEvent(bestDropset, bestDropset->acquiredPrimeE[i], bipartitionsById, mergingBipartitions);
+              FLIP_NTH_BIT(candidateBips, newBipId);
+            }
+
+          FOR_0_LIMIT(i, bestDropset->numberOfComplexEvents)
+            {
+              newBipId = cleanup_applyOneMergerEvent(bestDropset, bestDropset->complexEvents + i, bipartitionsById, mergingBipartitions);
+              FLIP_NTH_BIT(candidateBips, newBipId);
+            }
         }
     }
 
@@ -1641,8 +1781,8 @@ void cleanup_rehashDropsets(HashTable *mergingHash, Dropset *bestDropset)
   if(maxDropsetSize == 1)
     return;
 
-  IndexList
-    *taxaToDrop = bestDropset->taxaToDrop;
+  const TaxonSet
+    *taxaToDrop = &bestDropset->taxaToDrop;
 
   List *allDropsets = NULL;
   HashTableIterator *htIter;
@@ -1663,23 +1803,23 @@ void cleanup_rehashDropsets(HashTable *mergingHash, Dropset *bestDropset)
     if( NOT dropset)
       break;
 
-    if(NOT dropset->ownPrimeE || isSubsetOf(dropset->taxaToDrop, taxaToDrop) )
+    if(NOT dropset->numberOfOwnPrimeE || taxonSetIsSubsetOf(&dropset->taxaToDrop, taxaToDrop) )
       {
         removeElementFromHash(mergingHash, dropset);
-        freeDropsetDeep(dropset, FALSE);
+        freeDropsetDeep(dropset);
       }
-    else if(haveIntersection(dropset->taxaToDrop, taxaToDrop)) /* needs reinsert */
+    else if(taxonSetsIntersect(&dropset->taxaToDrop, taxaToDrop)) /* needs reinsert */
       {
         removeElementFromHash(mergingHash, dropset);
 
 #ifdef MYDEBUG_NOTWORKING
-        int length = lengthIndexList(dropset->taxaToDrop);
+        int length = dropset->taxaToDrop.numberOfTaxa;
 #endif
 
-        dropset->taxaToDrop = setMinusOf(dropset->taxaToDrop, taxaToDrop);
+        taxonSetMinus(&dropset->taxaToDrop, taxaToDrop);
 
 #ifdef MYDEBUG_NOTWORKING
-        assert(length > lengthIndexList(dropset->taxaToDrop));
+        assert(length > dropset->taxaToDrop.numberOfTaxa);
 #endif
         uint32_t hv = mergingHash->hashFunction(mergingHash, dropset);
         Dropset *found = searchHashTable(mergingHash, dropset, hv);
@@ -1687,17 +1827,9 @@ void cleanup_rehashDropsets(HashTable *mergingHash, Dropset *bestDropset)
           insertIntoHashTable(mergingHash,dropset,hv);
         else                        /* reuse the merging events */
           {
-            List
-              *iter, *next;
-            for(iter = dropset->ownPrimeE; iter; iter = next)
-              {
-                /* TODO potential error: double check, if this stuff did not already occur would be great */
-                next = iter->next;
-                iter->next = found->ownPrimeE;
-                found->ownPrimeE = iter;
-              }
-            freeIndexList(dropset->taxaToDrop);
-            free(dropset);
+            /* TODO potential error: double check, if this stuff did not already occur would be great */
+            moveOwnEvents(dropset, found);
+            freeDropsetDeep(dropset);
           }
       }
   }
@@ -1706,8 +1838,8 @@ void cleanup_rehashDropsets(HashTable *mergingHash, Dropset *bestDropset)
 
 BitVector *cleanup(All *tr, HashTable *mergingHash, Dropset *bestDropset, BitVector *candidateBips, Array *bipartitionProfile, Array *bipartitionsById)
 {
-  IndexList
-    *ilIter;
+  int
+    i;
 
   BitVector
     *bipsToVanish = CALLOC(GET_BITVECTOR_LENGTH(bipartitionsById->length), sizeof(BitVector));
@@ -1722,9 +1854,11 @@ BitVector *cleanup(All *tr, HashTable *mergingHash, Dropset *bestDropset, BitVec
     }
 
   /* add to list of dropped taxa */
-  ilIter = bestDropset->taxaToDrop;
-  FOR_LIST(ilIter)
-    FLIP_NTH_BIT(droppedTaxa,ilIter->index);
+  FOR_0_LIMIT(i, bestDropset->taxaToDrop.numberOfTaxa)
+    {
+      FLIP_NTH_BIT(droppedTaxa, GET_TAXA(&bestDropset->taxaToDrop)[i]);
+      remainingFingerprint ^= taxonKey(GET_TAXA(&bestDropset->taxaToDrop)[i]);
+    }
 
   /* remove merging bipartitions from arrays (not candidates) */
   cleanup_updateNumBitsAndCleanArrays(bipartitionProfile, bipartitionsById, bipsToVanish,candidateBips,bestDropset );
@@ -1734,7 +1868,6 @@ BitVector *cleanup(All *tr, HashTable *mergingHash, Dropset *bestDropset, BitVec
   cleanup_rehashDropsets(mergingHash, bestDropset);
 
 #ifdef PRINT_VERY_VERBOSE
-  int i;
   PR("CLEAN UP: need to recompute bipartitions ");
   FOR_0_LIMIT(i, bipartitionProfile->length)
     if(NTH_BIT_IS_SET(candidateBips, i))
@@ -1776,11 +1909,17 @@ typedef enum {ERR_NONE = 0,
               ERR_TREE_INIT,
               ERR_BIG_DROPSET,
               ERR_ROGUE_MODE,
-              ERR_BITS_EQUAL} errcode;
-
-errcode doomRogues(All *tr, const char *bootStrapFileName,
-                   const char *dontDropFile,
-                   const char *treeFile, boolean mreOptimisation, double rawThresh)
+              ERR_BITS_EQUAL,
+              ERR_BAD_TREES,
+              ERR_UNKNOWN_TAXON} errcode;
+
+/* profileCache names the file to load the bipartition profile from
+   (or to store it in, if it does not match the trees), it is not used,
+   if empty. The profile is built by numberOfThreads threads. */
+errcode doomRogues(All *tr, TreeFile *bootstrapTrees,
+                   const char * const *dontDrop, int numberOfDontDrop,
+                   TreeFile *bestTree, boolean mreOptimisation, double rawThresh,
+                   const char *profileCache, int numberOfThreads)
 {
   GetRNGstate();
   double startingTime = gettime();
@@ -1791,7 +1930,6 @@ errcode doomRogues(All *tr, const char *bootStrapFileName,
     i;
 
   FILE
-    *bootstrapTreesFile = getNumberOfTrees(tr, bootStrapFileName),
     *rogueOutput = getOutputFileFromString("droppedRogues");
 
   BitVector
@@ -1802,7 +1940,7 @@ errcode doomRogues(All *tr, const char *bootStrapFileName,
 
   numberOfTrees = tr->numberOfTrees;
 
-  if(strlen(treeFile))
+  if(bestTree)
     {
       rogueMode = ML_TREE_OPT;
       if(mreOptimisation)
@@ -1830,14 +1968,41 @@ errcode doomRogues(All *tr, const char *bootStrapFileName,
            "consensus if it occurs in more than %d trees\n", thresh);
     }
 
-  FILE
-    *bestTree = (rogueMode == ML_TREE_OPT) ? myfopen(treeFile,"r") : NULL;
-
   mxtips = tr->mxtips;
-  tr->bitVectorLength = GET_BITVECTOR_LENGTH(mxtips);
+
+  /* the taxon vectors are padded to a width with specialized kernels */
+  tr->bitVectorLength = getKernelBitVectorLength(mxtips);
+
+  neglectThose = neglectThoseTaxa(tr, dontDrop, numberOfDontDrop);
+  if( NOT neglectThose)
+    {
+      fclose(rogueOutput);
+      return ERR_UNKNOWN_TAXON;
+    }
 
   Array
-    *bipartitionProfile = getOriginalBipArray(tr, bestTree, bootstrapTreesFile);
+    *bipartitionProfile = NULL;
+
+  if(strlen(profileCache))
+    {
+      uint64_t
+        sourceHash = hashTreeSources(bootstrapTrees, bestTree);
+
+      bipartitionProfile = loadProfileCache(tr, profileCache, sourceHash, bestTree != NULL);
+      if( NOT bipartitionProfile)
+        {
+          bipartitionProfile = getOriginalBipArray(tr, bestTree, bootstrapTrees, numberOfThreads);
+          writeProfileCache(tr, bipartitionProfile, profileCache, sourceHash, bestTree != NULL);
+        }
+    }
+  else
+    bipartitionProfile = getOriginalBipArray(tr, bestTree, bootstrapTrees, numberOfThreads);
+
+  if(tr->treeWeights)
+    PR("the %d trees have %d distinct topologies\n", tr->numberOfTrees, tr->numberOfTreeColumns);
+
+  BipartitionStore
+    *store = ((ProfileElemAttr*)bipartitionProfile->commonAttributes)->store;
 
   if(maxDropsetSize >= mxtips - 3)
     {
@@ -1852,30 +2017,40 @@ errcode doomRogues(All *tr, const char *bootStrapFileName,
   Dropset
     *bestDropset = NULL;
 
-  neglectThose = neglectThoseTaxa(tr, dontDropFile);
-
   initializeRandForTaxa(mxtips);
-
-  treeVectorLength = GET_BITVECTOR_LENGTH(tr->numberOfTrees);
-  bitVectorLength = GET_BITVECTOR_LENGTH(tr->mxtips);
+  initializeTaxonKeys(mxtips);
+
+  /* tree vectors have a column per distinct topology */
+  treeVectorLength = GET_BITVECTOR_LENGTH(tr->numberOfTreeColumns);
+  treeWeights = tr->treeWeights;
+  bitVectorLength = tr->bitVectorLength;
+  assert(store->bitVectorLength == (uint32_t)bitVectorLength);
+  selectBitVectorKernels(bitVectorLength);
   droppedTaxa = CALLOC(bitVectorLength, sizeof(BitVector));
 
-  paddingBits = CALLOC(GET_BITVECTOR_LENGTH(mxtips), sizeof(BitVector));
-  for(i = mxtips; i < GET_BITVECTOR_LENGTH(mxtips) * MASK_LENGTH; ++i)
+  paddingBits = CALLOC(bitVectorLength, sizeof(BitVector));
+  for(i = mxtips; i < bitVectorLength * MASK_LENGTH; ++i)
     FLIP_NTH_BIT(paddingBits,i);
 
-  FOR_0_LIMIT(i, bipartitionProfile->length)
+  remainingFingerprint = 0;
+  FOR_0_LIMIT(i, mxtips)
+    remainingFingerprint ^= taxonKey(i);
+
+  FOR_0_LIMIT(i, store->length)
     {
-      ProfileElem *elem = ((ProfileElem**)bipartitionProfile->arrayTable)[i];
+      ProfileElem *elem = store->elems + i;
       elem->numberOfBitsSet = genericBitCount(elem->bitVector, bitVectorLength);
+      computeSignature(elem->bitVector, NULL, NULL, elem->signature, bitVectorLength);
+#ifdef MYDEBUG
+      assert(elem->fingerprint == bitVectorFingerprint(elem->bitVector, bitVectorLength));
+#endif
     }
 
-  Array *bipartitionsById = createArray(bipartitionProfile->length, sizeof(ProfileElem*));
-  bipartitionsById->length = bipartitionProfile->length;
+  /* the element with id i is the i-th of the store */
+  Array *bipartitionsById = createArray(store->length, sizeof(ProfileElem*));
+  bipartitionsById->length = store->length;
   FOR_0_LIMIT(i,bipartitionsById->length)
-    GET_PROFILE_ELEM(bipartitionsById, i) = GET_PROFILE_ELEM(bipartitionProfile, i);
-  qsort(bipartitionsById->arrayTable, bipartitionsById->length,
-        sizeof(ProfileElem**), sortById);
+    GET_PROFILE_ELEM(bipartitionsById, i) = store->elems + i;
 
   numBips = bipartitionProfile->length;
 
@@ -1895,7 +2070,7 @@ errcode doomRogues(All *tr, const char *bootStrapFileName,
   FOR_0_LIMIT(i,bipartitionProfile->length)
     FLIP_NTH_BIT(candidateBips,i);
 
-  mergingHash = createHashTable(tr->mxtips * maxDropsetSize * HASH_TABLE_SIZE_CONST,
+  mergingHash = createHashTable(tr->mxtips * maxDropsetSize,
                                 NULL,
                                 dropsetHashValue,
                                 dropsetEqual);
@@ -1921,7 +2096,7 @@ errcode doomRogues(All *tr, const char *bootStrapFileName,
       /* prepare */
       /***********/
       bestDropset = NULL;
-      unifyBipartitionRepresentation(bipartitionProfile,droppedTaxa);
+      unifyBipartitionRepresentation(bipartitionsById,droppedTaxa);
       indexByNumberBits = createNumBitIndex(bipartitionProfile, mxtips);
 
 #ifdef PRINT_TIME
@@ -1935,6 +2110,8 @@ errcode doomRogues(All *tr, const char *bootStrapFileName,
       /***********************************/
       /* create / update  merging events */
       /***********************************/
+      candidateIndex = createCandidateIndexIfWorthwhile(bipartitionProfile, bipartitionsById, candidateBips,
+                                                        firstMerge, indexByNumberBits);
 #ifdef PARALLEL
       numberOfJobs = bipartitionProfile->length;
       globalPArgs->mergingHash = mergingHash;
@@ -1951,6 +2128,9 @@ errcode doomRogues(All *tr, const char *bootStrapFileName,
                                 indexByNumberBits);
 #endif
       firstMerge = FALSE;
+      if(candidateIndex)
+        freeCandidateIndex(candidateIndex);
+      candidateIndex = NULL;
 
 #ifdef MYDEBUG_NOT_WORKING
       debug_dropsetConsistencyCheck(mergingHash);
@@ -2026,7 +2206,7 @@ errcode doomRogues(All *tr, const char *bootStrapFileName,
       PR("\n");
 #endif
       if(bestDropset)
-        taxaDropped += lengthIndexList(bestDropset->taxaToDrop);
+        taxaDropped += bestDropset->taxaToDrop.numberOfTaxa;
 
       dropRound++;
     } while(bestDropset);
@@ -2037,52 +2217,56 @@ errcode doomRogues(All *tr, const char *bootStrapFileName,
   PR("total time elapsed: %f\n", updateTime(&startingTime));
 
   /* free everything */
-  FOR_0_LIMIT(i, bipartitionProfile->length)
-    {
-      ProfileElem *elem = GET_PROFILE_ELEM(bipartitionProfile,i);
-      if(elem)
-          freeProfileElem(elem);
-    }
+  freeBipartitionStore(store);
   freeArray(bipartitionProfile);
   freeArray(bipartitionsById);
-  destroyHashTable(mergingHash, freeDropsetDeepInHash);
+  destroyHashTable(mergingHash, freeDropsetDeep);
 
   fclose(rogueOutput);
   for(i = 0; i != dropRound + 1; ++i)
     {
       Dropset *theDropset = dropsetPerRound[i];
       if(theDropset)
-        freeDropsetDeepInEnd(theDropset);
+        freeDropsetDeep(theDropset);
     }
   free(dropsetPerRound);
   free(neglectThose);
   free(cumScores);
   free(paddingBits);
   free(randForTaxa);
+  freeTaxonKeys();
+  freeDropsetPool();
+  free(unionCursors);
+  unionCursors = NULL;
+  unionCursorsLength = 0;
   free(droppedTaxa);
   free(candidateBips);
   return ERR_NONE;
 }
 
-SEXP RogueNaRok (SEXP R_bootTrees, // Character
-                 SEXP R_run_id, // Character
-                 SEXP R_treeFile, // Character
-                 SEXP R_computeSupport, // Logical
-                 SEXP R_maxDropsetSize, // Integer
-                 SEXP R_excludeFile, // Character
-                 SEXP R_workdir, // Character
-                 SEXP R_labelPenalty, // Double
-                 SEXP R_mreOptimization, // Logical
-                 SEXP R_threshold) // Double
+/* runs the analysis on trees that are already indexed; the
+   exclusions are either read from excludeFile or given by name.
+   validTrees is FALSE, if the trees given could not be read.
+   The bipartition profile is cached in profileCache, if not empty,
+   and built by R_threads threads. */
+static SEXP runRogueNaRok(TreeFile *bootTrees,
+                          TreeFile *bestTree,
+                          boolean validTrees,
+                          const char *profileCache,
+                          const char *excludeFile,
+                          SEXP R_excludeNames,
+                          SEXP R_run_id,
+                          SEXP R_computeSupport,
+                          SEXP R_maxDropsetSize,
+                          SEXP R_workdir,
+                          SEXP R_labelPenalty,
+                          SEXP R_mreOptimization,
+                          SEXP R_threshold,
+                          SEXP R_threads)
 {
   int threshold = 50;
   errcode error = ERR_NONE;
 
-  const char
-    *excludeFile = CHAR(STRING_ELT(R_excludeFile, 0)),
-    *bootTrees = CHAR(STRING_ELT(R_bootTrees, 0)),
-    *treeFile = CHAR(STRING_ELT(R_treeFile, 0));
-
   boolean
     mreOptimisation = FALSE;
 
@@ -2116,8 +2300,8 @@ SEXP RogueNaRok (SEXP R_bootTrees, // Character
     }
 
 
-  /* initialize fast bit counting */
-  compute_bits_in_16bits();
+  /* choose the bit counting kernels for this cpu */
+  initializeBitVectorKernels();
   initializeMask();
 
 #ifdef PARALLEL
@@ -2134,12 +2318,12 @@ SEXP RogueNaRok (SEXP R_bootTrees, // Character
     }
 #endif
 
-  if( NOT strcmp(treeFile, ""))
+  if( NOT validTrees)
     {
-      rogueMode = ML_TREE_OPT;
+      REprintf("ERROR: The trees given could not be read.\n");
+      error = ERR_BAD_TREES;
     }
-
-  if( NOT strcmp(bootTrees, ""))
+  else if( NOT bootTrees)
     {
       REprintf("ERROR: Please specify a file containing bootstrap trees via -i.\n");
       error = ERR_NO_TREE;
@@ -2157,7 +2341,7 @@ SEXP RogueNaRok (SEXP R_bootTrees, // Character
       error = ERR_LOW_THRESHOLD;
     }
 
-  if(threshold != 50 && strcmp(treeFile, "") )
+  if(threshold != 50 && bestTree )
     {
       REprintf("ERROR: threshold option -c not available in combination with best-known tree.\n");
       error = ERR_NO_BEST_TREE;
@@ -2166,22 +2350,54 @@ SEXP RogueNaRok (SEXP R_bootTrees, // Character
   All
     *tr = CALLOC(1,sizeof(All));
   setupInfoFile();
-  if  (NOT setupTree(tr, bootTrees))
+  if  (error == ERR_NONE && NOT setupTree(tr, bootTrees))
     {
       PR("Something went wrong during tree initialisation. Sorry.\n");
       error = ERR_TREE_INIT;
     }
 
   if (error == ERR_NONE) {
+    char
+      **dontDrop = NULL;
+
+    int
+      i,
+      numberOfDontDrop = 0;
+
+    if(strlen(excludeFile))
+      {
+        FILE
+          *toDrop = myfopen(excludeFile, "r");
+        dontDrop = parseToDrop(toDrop, &numberOfDontDrop);
+        fclose(toDrop);
+      }
+    else if(R_excludeNames != R_NilValue)
+      {
+        numberOfDontDrop = LENGTH(R_excludeNames);
+        dontDrop = CALLOC(numberOfDontDrop, sizeof(char*));
+        FOR_0_LIMIT(i, numberOfDontDrop)
+          dontDrop[i] = strdup(CHAR(STRING_ELT(R_excludeNames, i)));
+      }
+
     error = doomRogues(tr,
                        bootTrees,
-                       excludeFile,
-                       treeFile,
+                       (const char * const *)dontDrop,
+                       numberOfDontDrop,
+                       bestTree,
                        mreOptimisation,
-                       threshold);
+                       threshold,
+                       profileCache,
+                       MAX(*INTEGER(R_threads), 1));
+
+    FOR_0_LIMIT(i, numberOfDontDrop)
+      free(dontDrop[i]);
+    free(dontDrop);
   }
 
-  freeTree(tr);
+  if(tr->nameList)
+    freeTree(tr);
+  else
+    free(tr);
   destroyMask(); // free(mask32);
   destroyInfoFile(); // free(infoFileName);
 
@@ -2195,3 +2411,213 @@ SEXP RogueNaRok (SEXP R_bootTrees, // Character
 
   return Rres;
 }
+
+
+/* R_profileCache names a file that keeps the bipartition profile of
+   the trees between calls; it is not used, if empty. R_threads is the
+   number of threads that build the profile. */
+SEXP RogueNaRok (SEXP R_bootTrees, // Character
+                 SEXP R_run_id, // Character
+                 SEXP R_treeFile, // Character
+                 SEXP R_computeSupport, // Logical
+                 SEXP R_maxDropsetSize, // Integer
+                 SEXP R_excludeFile, // Character
+                 SEXP R_workdir, // Character
+                 SEXP R_labelPenalty, // Double
+                 SEXP R_mreOptimization, // Logical
+                 SEXP R_threshold, // Double
+                 SEXP R_profileCache, // Character
+                 SEXP R_threads) // Integer
+{
+  const char
+    *excludeFile = CHAR(STRING_ELT(R_excludeFile, 0)),
+    *bootTrees = CHAR(STRING_ELT(R_bootTrees, 0)),
+    *treeFile = CHAR(STRING_ELT(R_treeFile, 0));
+
+  TreeFile
+    *bootTreeFile = strlen(bootTrees) ? openTreeFile(bootTrees) : NULL,
+    *bestTreeFile = strlen(treeFile) ? openTreeFile(treeFile) : NULL;
+
+  boolean
+    validTrees = (bootTreeFile || NOT strlen(bootTrees)) && (bestTreeFile || NOT strlen(treeFile));
+
+  SEXP
+    Rres = runRogueNaRok(bootTreeFile, bestTreeFile, validTrees,
+                         CHAR(STRING_ELT(R_profileCache, 0)), excludeFile, R_NilValue,
+                         R_run_id, R_computeSupport, R_maxDropsetSize, R_workdir,
+                         R_labelPenalty, R_mreOptimization, R_threshold, R_threads);
+
+  if(bootTreeFile)
+    closeTreeFile(bootTreeFile);
+  if(bestTreeFile)
+    closeTreeFile(bestTreeFile);
+
+  return Rres;
+}
+
+
+/* indexes trees held by R: either a character vector of Newick
+   strings or a list of integer edge matrices (with tip labels). Sets
+   *result to NULL, if there are no trees. Returns FALSE, if the trees
+   cannot be read. */
+static boolean treeFileFromR(SEXP R_trees, SEXP R_tipLabels, TreeFile **result)
+{
+  R_xlen_t
+    length = XLENGTH(R_trees);
+
+  size_t
+    i,
+    numberOfTrees;
+
+  *result = NULL;
+
+  if(length == 0)
+    return TRUE;
+
+  if(length < 0 || length > INT_MAX)
+    {
+      REprintf("ERROR: Cannot process %ld trees.\n", (long)length);
+      return FALSE;
+    }
+
+  numberOfTrees = (size_t)length;
+
+  if(isString(R_trees))
+    {
+      const char
+        **trees = CALLOC(numberOfTrees, sizeof(char*));
+
+      FOR_0_LIMIT(i, numberOfTrees)
+        trees[i] = CHAR(STRING_ELT(R_trees, i));
+
+      *result = createTreeFileFromStrings(trees, (int)numberOfTrees);
+      free(trees);
+    }
+  else if(isNewList(R_trees) || isMatrix(R_trees))
+    {
+      boolean
+        isSingleTree = isMatrix(R_trees);
+
+      const int
+        **edges;
+
+      int
+        *numberOfEdges;
+
+      const char
+        **tipLabels;
+
+      size_t
+        numberOfTips;
+
+      if(isSingleTree)
+        numberOfTrees = 1;
+
+      if( NOT isString(R_tipLabels))
+        {
+          REprintf("ERROR: Trees given as edge matrices require a vector of tip labels.\n");
+          return FALSE;
+        }
+
+      numberOfTips = (size_t)XLENGTH(R_tipLabels);
+      if(numberOfTips > INT_MAX)
+        {
+          REprintf("ERROR: Cannot process %lu tip labels.\n", (unsigned long)numberOfTips);
+          return FALSE;
+        }
+
+      FOR_0_LIMIT(i, numberOfTrees)
+        {
+          SEXP
+            edge = isSingleTree ? R_trees : VECTOR_ELT(R_trees, i);
+
+          if( NOT isInteger(edge) || NOT isMatrix(edge) || ncols(edge) != 2)
+            {
+              REprintf("ERROR: Tree %lu is not an integer edge matrix with two columns.\n", (unsigned long)i + 1);
+              return FALSE;
+            }
+        }
+
+      edges = CALLOC(numberOfTrees, sizeof(int*));
+      numberOfEdges = CALLOC(numberOfTrees, sizeof(int));
+      tipLabels = CALLOC(numberOfTips, sizeof(char*));
+
+      FOR_0_LIMIT(i, numberOfTrees)
+        {
+          SEXP
+            edge = isSingleTree ? R_trees : VECTOR_ELT(R_trees, i);
+          edges[i] = INTEGER(edge);
+          numberOfEdges[i] = nrows(edge);
+        }
+
+      FOR_0_LIMIT(i, numberOfTips)
+        tipLabels[i] = CHAR(STRING_ELT(R_tipLabels, i));
+
+      *result = createTreeFileFromEdges(edges, numberOfEdges, (int)numberOfTrees,
+                                        tipLabels, (int)numberOfTips);
+
+      free(edges);
+      free(numberOfEdges);
+      free(tipLabels);
+    }
+  else
+    REprintf("ERROR: Trees must be given as Newick strings or edge matrices.\n");
+
+  return *result != NULL;
+}
+
+
+/* like RogueNaRok(), but takes the trees from memory instead of
+   files. R_bootTrees and R_bestTree are character vectors of Newick
+   strings or (lists of) integer edge matrices as in ape's phylo class,
+   whose tips are labelled by R_tipLabels. An empty R_bestTree means
+   that there is no best-known tree. R_exclude holds the labels of
+   taxa that must not be dropped. R_profileCache names a file that
+   keeps the bipartition profile of the trees between calls; it is not
+   used, if empty. R_threads is the number of threads that build the
+   profile. */
+SEXP RogueNaRokTrees (SEXP R_bootTrees, // Character or list of integer matrices
+                      SEXP R_tipLabels, // Character
+                      SEXP R_run_id, // Character
+                      SEXP R_bestTree, // Character or integer matrix
+                      SEXP R_computeSupport, // Logical
+                      SEXP R_maxDropsetSize, // Integer
+                      SEXP R_exclude, // Character
+                      SEXP R_workdir, // Character
+                      SEXP R_labelPenalty, // Double
+                      SEXP R_mreOptimization, // Logical
+                      SEXP R_threshold, // Double
+                      SEXP R_profileCache, // Character
+                      SEXP R_threads) // Integer
+{
+  TreeFile
+    *bootTreeFile,
+    *bestTreeFile;
+
+  boolean
+    validTrees = treeFileFromR(R_bootTrees, R_tipLabels, &bootTreeFile);
+
+  SEXP
+    Rres;
+
+  if( NOT treeFileFromR(R_bestTree, R_tipLabels, &bestTreeFile))
+    validTrees = FALSE;
+
+  if(bestTreeFile && bestTreeFile->numberOfTrees == 0)
+    {
+      closeTreeFile(bestTreeFile);
+      bestTreeFile = NULL;
+    }
+
+  Rres = runRogueNaRok(bootTreeFile, bestTreeFile, validTrees,
+                       CHAR(STRING_ELT(R_profileCache, 0)), "", R_exclude,
+                       R_run_id, R_computeSupport, R_maxDropsetSize, R_workdir,
+                       R_labelPenalty, R_mreOptimization, R_threshold, R_threads);
+
+  if(bootTreeFile)
+    closeTreeFile(bootTreeFile);
+  if(bestTreeFile)
+    closeTreeFile(bestTreeFile);
+
+  return Rres;
+}
@@ -31,117 +31,161 @@
 
 #include "Tree.h"
 
-static int treeGetCh (FILE *fp) ;
-static void insertHashBootstop(uint32_t *bitVector, hashtable *h, uint32_t vectorLength, int treeNumber, int treeVectorLength, uint32_t position);
-static void  treeEchoContext (FILE *fp1, int n);
+#ifndef WIN32
+#include <fcntl.h>
+#include <sys/stat.h>
+#endif
+
+static int treeGetCh (TreeReader *fp) ;
+static void treeUngetc(int ch, TreeReader *fp);
+static boolean treeGetLabel (TreeReader *fp, char *lblPtr, int maxlen);
+static boolean treeFlushLabel (TreeReader *fp);
+static int treeFlushLen (TreeReader *fp);
+static void initTreeReader(TreeReader *reader, TreeFile *file, int treeNumber);
+static void insertHashBootstop(uint32_t *bitVector, hashtable *h, int treeNumber, uint64_t hash);
+static void  treeEchoContext (TreeReader *fp1, int n);
 boolean isTip(int number, int maxTips);
 void getxnode (nodeptr p);
-static void insertHashAll(uint32_t *bitVector, hashtable *h, uint32_t vectorLength, int treeNumber,  uint32_t position);
-static void insertHash(uint32_t *bitVector, hashtable *h, uint32_t vectorLength, int bipNumber, uint32_t position);
-static int countHash(uint32_t *bitVector, hashtable *h, uint32_t vectorLength, uint32_t position);
-
-
-static uint32_t KISS32(void)
-{
-  static uint32_t
-    x = 123456789,
-    y = 362436069,
-    z = 21288629,
-    w = 14921776,
-    c = 0;
-
-  uint32_t t;
-
-  x += 545925293;
-  y ^= (y<<13);
-  y ^= (y>>17);
-  y ^= (y<<5);
-  t = z + w + c;
-  z = w;
-  c = (t>>31);
-  w = t & 2147483647;
-
-  return (x+y+w);
-}
+static void insertHashAll(uint32_t *bitVector, hashtable *h, int treeNumber, uint64_t hash);
+static void insertHash(uint32_t *bitVector, hashtable *h, int bipNumber, uint64_t hash);
+static int countHash(uint32_t *bitVector, hashtable *h, uint64_t hash);
 
 
+/* the label interner is an open-addressing table (linear probing)
+   that keeps the hash of every label, s.t. it can grow without
+   rehashing the strings */
 stringHashtable *initStringHashTable(uint32_t n)
 {
-  static const uint32_t initTable[] = {53, 97, 193, 389, 769, 1543, 3079, 6151, 12289, 24593, 49157, 98317,
-                         196613, 393241, 786433, 1572869, 3145739, 6291469, 12582917, 25165843,
-                         50331653, 100663319, 201326611, 402653189, 805306457, 1610612741};
-
   stringHashtable *h = (stringHashtable*)malloc(sizeof(stringHashtable));
 
   uint32_t
-    tableSize,
-    i,
-    primeTableLength = sizeof(initTable)/sizeof(initTable[0]);
+    tableSize = 64;
 
+  while(tableSize < 2 * n)
+    tableSize *= 2;
 
+  h->tableSize = tableSize;
+  h->entryCount = 0;
+  h->hashes = (uint32_t*)calloc(tableSize, sizeof(uint32_t));
+  h->nodeNumbers = (int*)calloc(tableSize, sizeof(int));
+  h->words = (char**)calloc(tableSize, sizeof(char*));
 
-  i = 0;
+  return h;
+}
 
-  while(initTable[i] < n && i < primeTableLength)
-    i++;
 
-  assert(i < primeTableLength);
+void freeStringHashTable(stringHashtable *h)
+{
+  free(h->hashes);
+  free(h->nodeNumbers);
+  free(h->words);
+  free(h);
+}
 
-  tableSize = initTable[i];
 
-  h->table = (stringEntry**)calloc(tableSize, sizeof(stringEntry*));
-  h->tableSize = tableSize;
+/* FNV-1a */
+static uint32_t hashString(const char *p)
+{
+  uint32_t h = 2166136261U;
+
+  for(; *p; p++)
+    h = (h ^ (unsigned char)*p) * 16777619U;
 
   return h;
 }
 
 
-static uint32_t hashString(char *p, uint32_t tableSize)
+/* returns the slot of s or the empty slot where s belongs */
+static uint32_t findSlot(const stringHashtable *h, const char *s, uint32_t hash)
 {
-  uint32_t h = 0;
+  uint32_t
+    mask = h->tableSize - 1,
+    position = hash & mask;
 
-  for(; *p; p++)
-    h = 31 * h + *p;
+  while(h->nodeNumbers[position]
+        && (h->hashes[position] != hash || strcmp(s, h->words[position])))
+    position = (position + 1) & mask;
 
-  return (h % tableSize);
+  return position;
 }
 
 
-void addword(char *s, stringHashtable *h, int nodeNumber)
+static void growStringHashTable(stringHashtable *h)
 {
-  uint32_t position = hashString(s, h->tableSize);
-  stringEntry *p = h->table[position];
+  uint32_t
+    i,
+    oldSize = h->tableSize,
+    *oldHashes = h->hashes;
 
-  for(; p!= NULL; p = p->next)
-    {
-      if(strcmp(s, p->word) == 0)
-          return;
-    }
+  int
+    *oldNodeNumbers = h->nodeNumbers;
+
+  char
+    **oldWords = h->words;
 
-  p = (stringEntry *)malloc(sizeof(stringEntry));
+  h->tableSize *= 2;
+  h->hashes = (uint32_t*)calloc(h->tableSize, sizeof(uint32_t));
+  h->nodeNumbers = (int*)calloc(h->tableSize, sizeof(int));
+  h->words = (char**)calloc(h->tableSize, sizeof(char*));
 
-  assert(p);
+  FOR_0_LIMIT(i, oldSize)
+    if(oldNodeNumbers[i])
+      {
+        uint32_t
+          position = oldHashes[i] & (h->tableSize - 1);
+
+        while(h->nodeNumbers[position])
+          position = (position + 1) & (h->tableSize - 1);
 
-  p->nodeNumber = nodeNumber;
-  p->word = (char *)malloc((strlen(s) + 1) * sizeof(char));
+        h->hashes[position] = oldHashes[i];
+        h->nodeNumbers[position] = oldNodeNumbers[i];
+        h->words[position] = oldWords[i];
+      }
 
-  strcpy(p->word, s);
-  /* free(s); */
+  free(oldHashes);
+  free(oldNodeNumbers);
+  free(oldWords);
+}
 
-  p->next =  h->table[position];
 
-  h->table[position] = p;
+/* interns s (which is not copied and must outlive the table) under
+   nodeNumber. Returns FALSE, if s is already in the table. */
+boolean addword(char *s, stringHashtable *h, int nodeNumber)
+{
+  uint32_t
+    hash = hashString(s),
+    position = findSlot(h, s, hash);
+
+  assert(nodeNumber > 0);
+
+  if(h->nodeNumbers[position])
+    return FALSE;
+
+  h->hashes[position] = hash;
+  h->nodeNumbers[position] = nodeNumber;
+  h->words[position] = s;
+  h->entryCount++;
+
+  /* keep the load factor below 1/2 */
+  if(2 * h->entryCount > h->tableSize)
+    growStringHashTable(h);
+
+  return TRUE;
 }
 
 
-int getNumberOfTaxa(All *tr, const char *bootStrapFile)
+int getNumberOfTaxa(All *tr, TreeFile *trees)
 {
-  FILE *f = myfopen(bootStrapFile, "rb");
+  TreeReader
+    reader;
 
   char
     **nameList,
     buffer[nmlngth + 2];
 
+  stringHashtable
+    *nameHash;
+
   int
     i = 0,
     c,
@@ -149,35 +193,21 @@ int getNumberOfTaxa(All *tr, const char *bootStrapFile)
     taxaCount = 0;
 
   nameList = (char**)malloc(sizeof(char*) * taxaSize);
+  nameHash = initStringHashTable(taxaSize);
+
+  initTreeReader(&reader, trees, 0);
 
-  while((c = fgetc(f)) != ';')
+  while((c = treeGetCh(&reader)) != ';' && c != EOF)
     {
-      if(c == '(' || c == ',')
+      if(c == ')')
+        (void) treeFlushLabel(&reader);
+      else if(c == '(' || c == ',')
     {
-      c = fgetc(f);
-      if(c ==  '(' || c == ',')
-        ungetc(c, f);
-      else
+      c = treeGetCh(&reader);
+      treeUngetc(c, &reader);
+      if(c != '(' && c != ',' && c != EOF
+         && treeGetLabel(&reader, buffer, nmlngth + 2))
         {
-          i = 0;
-
-          do
-          {
-            buffer[i++] = c;
-            c = fgetc(f);
-          }
-          while(c != ':' && c != ')' && c != ',');
-          buffer[i] = '\0';
-
-          for(i = 0; i < taxaCount; i++)
-          {
-            if(strcmp(buffer, nameList[i]) == 0)
-              {
-                REprintf("A taxon labelled by %s appears twice in the first tree of tree collection %s, exiting ...\n", buffer, bootStrapFile);
-                assert(0);
-              }
-          }
-
           if(taxaCount == taxaSize)
           {
             taxaSize *= 2;
@@ -187,15 +217,19 @@ int getNumberOfTaxa(All *tr, const char *bootStrapFile)
           nameList[taxaCount] = (char*)malloc(sizeof(char) * (strlen(buffer) + 1));
           strcpy(nameList[taxaCount], buffer);
 
-          taxaCount++;
+          if(NOT addword(nameList[taxaCount], nameHash, taxaCount + 1))
+            {
+              REprintf("A taxon labelled by %s appears twice in the first tree of tree collection %s, exiting ...\n", buffer, trees->name);
+              assert(0);
+            }
 
-          ungetc(c, f);
+          taxaCount++;
         }
     }
     }
 
   Rprintf("Found a total of %d taxa in first tree of tree collection %s\n",
-          taxaCount, bootStrapFile);
+          taxaCount, trees->name);
 
   tr->nameList = (char **)malloc(sizeof(char *) * (taxaCount + 1));
   for(i = 1; i <= taxaCount; i++)
@@ -203,32 +237,35 @@ int getNumberOfTaxa(All *tr, const char *bootStrapFile)
 
   free(nameList);
 
-  tr->nameHash = initStringHashTable(10 * taxaCount);
-  for(i = 1; i <= taxaCount; i++)
-    addword(tr->nameList[i], tr->nameHash, i);
-
-  fclose(f);
+  tr->nameHash = nameHash;
 
   return taxaCount;
 }
 
 
-boolean setupTree (All *tr, const char *bootstrapFile)
+boolean setupTree (All *tr, TreeFile *bootstrapTrees)
 {
   nodeptr p0, p, q;
   int
     i,
     j,
-    k,
     tips,
     inter;
 
-  tips = getNumberOfTaxa(tr, bootstrapFile);
+  if(bootstrapTrees->numberOfTrees == 0)
+    {
+      REprintf("ERROR: Found no trees in tree collection %s\n", bootstrapTrees->name);
+      return FALSE;
+    }
+
+  tips = getNumberOfTaxa(tr, bootstrapTrees);
   tr->mxtips = tips;
 
   tips  = tr->mxtips;
   inter = tr->mxtips - 1;
-  tr->numberOfTrees = -1;
+  tr->numberOfTrees = bootstrapTrees->numberOfTrees;
+  tr->numberOfTreeColumns = tr->numberOfTrees;
+  tr->treeWeights = NULL;
 
   if (NOT(p0 = (nodeptr) malloc((tips + 3*inter) * sizeof(node))))
     {
@@ -250,22 +287,13 @@ boolean setupTree (All *tr, const char *bootstrapFile)
     {
       p = p0++;
 
-      p->hash   =  KISS32(); /* hast table stuff */
+      p->hash   =  taxonKey(i - 1); /* hash table stuff */
       p->x      =  0;
       p->number =  i;
       p->next   =  p;
       p->back   = (node *)NULL;
       p->bInf   = (branchInfo *)NULL;
-
-
-      for(k = 0; k < NUM_BRANCHES; k++)
-    {
-      p->xs[k]    = 0;
-      p->backs[k] = (nodeptr)NULL;
-    }
-
-      for(k = 0; k < VECTOR_LENGTH; k++)
-    p->isPresent[k] = 0;
+      p->z      = (double *)NULL;
 
       tr->nodep[i] = p;
     }
@@ -285,24 +313,8 @@ boolean setupTree (All *tr, const char *bootstrapFile)
         p->bInf   = (branchInfo *)NULL;
         p->back   = (node *) NULL;
         p->hash   = 0;
-  
-        if(j == 1)
-          for(k = 0; k < NUM_BRANCHES; k++)
-            {
-          p->xs[k]    = 1;
-          p->backs[k] = (nodeptr)NULL;
-            }
-        else
-          for(k = 0; k < NUM_BRANCHES; k++)
-            {
-          p->xs[k]    = 0;
-          p->backs[k] = (nodeptr)NULL;
-            }
-  
-        for(k = 0; k < VECTOR_LENGTH; k++)
-          p->isPresent[k] = 0;
-  
-  
+        p->z      = (double *)NULL;
+
         q = p;
       }
       p->next->next->next = p;
@@ -323,7 +335,24 @@ boolean setupTree (All *tr, const char *bootstrapFile)
 
 nodeptr findAnyTip(nodeptr p, int numsp)
 {
-  return  isTip(p->number, numsp) ? p : findAnyTip(p->next->back, numsp);
+  while(NOT isTip(p->number, numsp))
+    p = p->next->back;
+
+  return p;
+}
+
+
+/* branch lengths are only stored for trees that carry any, thus
+   they are allocated when a branch is hooked up for the first time */
+static void allocateBranchLengths(nodeptr p, nodeptr q, int numBranches)
+{
+  if(numBranches == 0)
+    return;
+
+  if(NOT p->z)
+    p->z = CALLOC(NUM_BRANCHES, sizeof(double));
+  if(NOT q->z)
+    q->z = CALLOC(NUM_BRANCHES, sizeof(double));
 }
 
 
@@ -334,6 +363,8 @@ void hookupAdd(nodeptr p, nodeptr q, int numBranches)
   p->back = q;
   q->back = p;
 
+  allocateBranchLengths(p, q, numBranches);
+
   for(i = 0; i < numBranches; ++i)
     {
       p->z[i] += q->z[i];
@@ -349,93 +380,98 @@ void hookup (nodeptr p, nodeptr q, double *z, int numBranches)
   p->back = q;
   q->back = p;
 
+  allocateBranchLengths(p, q, numBranches);
+
   for(i = 0; i < numBranches; i++)
     p->z[i] = q->z[i] = z[i];
 }
 
 
+/* computes the split below the inner node p from the splits of its
+   two children, which must have been computed already */
 static void newviewBipartitions(BitVector **bitVectors, nodeptr p, int numsp, uint32_t vectorLength)
 {
-  if(isTip(p->number, numsp))
-    return;
-  {
-    nodeptr
-      q = p->next->back,
-      r = p->next->next->back;
-    uint32_t
-      *vector = bitVectors[p->number],
-      *left  = bitVectors[q->number],
-      *right = bitVectors[r->number];
-    unsigned
-      int i;
-
-    while(NOT p->x)
-      {
-    if(NOT p->x)
-      getxnode(p);
-      }
-
-    p->hash = q->hash ^ r->hash;
-
-    if(isTip(q->number, numsp) && isTip(r->number, numsp))
-      {
-    for(i = 0; i < vectorLength; i++)
-      vector[i] = left[i] | right[i];
-      }
-    else
-      {
-    if(isTip(q->number, numsp) || isTip(r->number, numsp))
-      {
-        if(isTip(r->number, numsp))
-          {
-        nodeptr tmp = r;
-        r = q;
-        q = tmp;
-          }
+  nodeptr
+    q = p->next->back,
+    r = p->next->next->back;
+  uint32_t
+    *vector = bitVectors[p->number],
+    *left  = bitVectors[q->number],
+    *right = bitVectors[r->number];
+  unsigned
+    int i;
 
-        while(NOT r->x)
-          {
-        if(NOT r->x)
-          newviewBipartitions(bitVectors, r, numsp, vectorLength);
-          }
+  assert(NOT isTip(p->number, numsp));
+  assert((isTip(q->number, numsp) || q->x) && (isTip(r->number, numsp) || r->x));
 
-        for(i = 0; i < vectorLength; i++)
-          vector[i] = left[i] | right[i];
-      }
-    else
-      {
-        while((NOT r->x) || (NOT q->x))
-          {
-        if(NOT q->x)
-          newviewBipartitions(bitVectors, q, numsp, vectorLength);
-        if(NOT r->x)
-          newviewBipartitions(bitVectors, r, numsp, vectorLength);
-          }
+  if(NOT p->x)
+    getxnode(p);
 
-        for(i = 0; i < vectorLength; i++)
-          vector[i] = left[i] | right[i];
-      }
+  p->hash = q->hash ^ r->hash;
 
-      }
-  }
+  for(i = 0; i < vectorLength; i++)
+    vector[i] = left[i] | right[i];
 }
 
 
-
+/* visits the inner nodes below p in post-order (children in the order
+   of the node ring) with an explicit stack, s.t. the depth of the
+   tree does not matter */
 void bitVectorInitravSpecial(uint32_t **bitVectors, nodeptr p, int numsp, uint32_t vectorLength, hashtable *h, int treeNumber, int function, branchInfo *bInf, int *countBranches, int treeVectorLength, boolean traverseOnly, boolean computeWRF)
 {
+  nodeptr
+    *stack;
+
+  boolean
+    *expanded;
+
+  int
+    top = 0;
+
   if(isTip(p->number, numsp))
     return;
-  else
-    {
-      nodeptr q = p->next;
 
-      do
+  stack = CALLOC(2 * numsp, sizeof(nodeptr));
+  expanded = CALLOC(2 * numsp, sizeof(boolean));
+
+  stack[top++] = p;
+
+  while(top > 0)
     {
-      bitVectorInitravSpecial(bitVectors, q->back, numsp, vectorLength, h, treeNumber, function, bInf, countBranches, treeVectorLength, traverseOnly, computeWRF);
-      q = q->next;
-    }
-      while(q != p);
+      p = stack[top - 1];
+
+      if(NOT expanded[top - 1])
+        {
+          nodeptr
+            q;
+
+          int
+            children = 0,
+            i;
+
+          expanded[top - 1] = TRUE;
+
+          for(q = p->next; q != p; q = q->next)
+            if(NOT isTip(q->back->number, numsp))
+              children++;
+
+          assert(top + children <= 2 * numsp);
+
+          /* pushed in reverse, s.t. p->next->back is visited first */
+          i = top + children;
+          for(q = p->next; q != p; q = q->next)
+            if(NOT isTip(q->back->number, numsp))
+              {
+                --i;
+                stack[i] = q->back;
+                expanded[i] = FALSE;
+              }
+          top += children;
+
+          continue;
+        }
+
+      top--;
 
       newviewBipartitions(bitVectors, p, numsp, vectorLength);
 
@@ -445,22 +481,23 @@ void bitVectorInitravSpecial(uint32_t **bitVectors, nodeptr p, int numsp, uint32
     {
       if(NOT(isTip(p->back->number, numsp)))
         *countBranches =  *countBranches + 1;
-      return;
+      continue;
     }
 
       if(NOT(isTip(p->back->number, numsp)))
     {
       uint32_t *toInsert  = bitVectors[p->number];
-      uint32_t position = p->hash % h->tableSize;
+
+      assert(h->vectorLength == vectorLength);
 
       switch(function)
         {
         case BIPARTITIONS_ALL:
-          insertHashAll(toInsert, h, vectorLength, treeNumber, position);
+          insertHashAll(toInsert, h, treeNumber, p->hash);
           *countBranches =  *countBranches + 1;
           break;
         case GET_BIPARTITIONS_BEST:
-          insertHash(toInsert, h, vectorLength, *countBranches, position);
+          insertHash(toInsert, h, *countBranches, p->hash);
 
           p->bInf            = &bInf[*countBranches];
           p->back->bInf      = &bInf[*countBranches];
@@ -472,14 +509,15 @@ void bitVectorInitravSpecial(uint32_t **bitVectors, nodeptr p, int numsp, uint32
           break;
         case DRAW_BIPARTITIONS_BEST:
           {
-        int found = countHash(toInsert, h, vectorLength, position);
+        int found = countHash(toInsert, h, p->hash);
         if(found >= 0)
           bInf[found].support =  bInf[found].support + 1;
         *countBranches =  *countBranches + 1;
           }
           break;
         case BIPARTITIONS_BOOTSTOP:
-          insertHashBootstop(toInsert, h, vectorLength, treeNumber, treeVectorLength, position);
+          assert(h->treeVectorLength == (uint32_t)treeVectorLength);
+          insertHashBootstop(toInsert, h, treeNumber, p->hash);
           *countBranches =  *countBranches + 1;
           break;
         default:
@@ -488,6 +526,9 @@ void bitVectorInitravSpecial(uint32_t **bitVectors, nodeptr p, int numsp, uint32
     }
 
     }
+
+  free(stack);
+  free(expanded);
 }
 
 
@@ -500,11 +541,26 @@ void hookupDefault (nodeptr p, nodeptr q, int numBranches)
   p->back = q;
   q->back = p;
 
+  allocateBranchLengths(p, q, numBranches);
+
   for(i = 0; i < numBranches; i++)
     p->z[i] = q->z[i] = defaultz;
 }
 
 
+static int treeGetc(TreeReader *fp)
+{
+  return (fp->pos < fp->end) ? (unsigned char)*(fp->pos)++ : EOF;
+}
+
+
+static void treeUngetc(int ch, TreeReader *fp)
+{
+  if(ch != EOF)
+    fp->pos--;
+}
+
+
 static boolean treeLabelEnd (int ch)
 {
   switch (ch)
@@ -527,7 +583,7 @@ static boolean treeLabelEnd (int ch)
   return FALSE;
 }
 
-static boolean  treeGetLabel (FILE *fp, char *lblPtr, int maxlen)
+static boolean  treeGetLabel (TreeReader *fp, char *lblPtr, int maxlen)
 {
   int      ch;
   boolean  done, quoted, lblfound;
@@ -538,14 +594,14 @@ static boolean  treeGetLabel (FILE *fp, char *lblPtr, int maxlen)
     if (lblPtr == NULL)
       maxlen = 0;
 
-  ch = getc(fp);
+  ch = treeGetc(fp);
   done = treeLabelEnd(ch);
 
   lblfound = NOT done;
   quoted = (ch == '\'');
   if (quoted && NOT done)
     {
-      ch = getc(fp);
+      ch = treeGetc(fp);
       done = (ch == EOF);
     }
 
@@ -555,7 +611,7 @@ static boolean  treeGetLabel (FILE *fp, char *lblPtr, int maxlen)
     {
       if (ch == '\'')
         {
-          ch = getc(fp);
+          ch = treeGetc(fp);
           if (ch != '\'')
         break;
         }
@@ -564,34 +620,28 @@ static boolean  treeGetLabel (FILE *fp, char *lblPtr, int maxlen)
     if (treeLabelEnd(ch)) break;
 
       if (--maxlen >= 0) *lblPtr++ = ch;
-      ch = getc(fp);
+      ch = treeGetc(fp);
       if (ch == EOF) break;
     }
 
-  if (ch != EOF)  (void) ungetc(ch, fp);
+  if (ch != EOF)  treeUngetc(ch, fp);
 
   if (lblPtr != NULL) *lblPtr = '\0';
 
   return lblfound;
 }
 
-static boolean  treeFlushLabel (FILE *fp)
+static boolean  treeFlushLabel (TreeReader *fp)
 {
   return  treeGetLabel(fp, (char *) NULL, (int) 0);
 }
 
 int lookupWord(char *s, stringHashtable *h)
 {
-  uint32_t position = hashString(s, h->tableSize);
-  stringEntry *p = h->table[position];
-
-  for(; p!= NULL; p = p->next)
-    {
-      if(strcmp(s, p->word) == 0)
-    return p->nodeNumber;
-    }
+  uint32_t
+    position = findSlot(h, s, hashString(s));
 
-  return -1;
+  return h->nodeNumbers[position] ? h->nodeNumbers[position] : -1;
 }
 
 
@@ -612,7 +662,7 @@ int treeFindTipByLabelString(char  *str, All *tr)
 }
 
 
-int treeFindTipName(FILE *fp, All *tr)
+int treeFindTipName(TreeReader *fp, All *tr)
 {
   char    str[nmlngth+2];
   int      n;
@@ -627,25 +677,43 @@ int treeFindTipName(FILE *fp, All *tr)
 }
 
 
-static boolean treeProcessLength (FILE *fp, double *dptr)
+static boolean treeProcessLength (TreeReader *fp, double *dptr)
 {
   int  ch;
+  size_t n = 0;
+  char
+    number[64],
+    *numberEnd;
 
   if ((ch = treeGetCh(fp)) == EOF)  return FALSE;    /*  Skip comments */
-  (void) ungetc(ch, fp);
+  treeUngetc(ch, fp);
+
+  /* the tree file is not NUL-terminated, thus copy the number before
+     converting it */
+  while(fp->pos + n < fp->end && n < sizeof(number) - 1
+        && strchr("0123456789.eE+-", fp->pos[n]))
+    {
+      number[n] = fp->pos[n];
+      n++;
+    }
+  number[n] = '\0';
 
-  if (fscanf(fp, "%lf", dptr) != 1) {
+  *dptr = strtod(number, &numberEnd);
+
+  if (numberEnd == number) {
     REprintf("ERROR: treeProcessLength: Problem reading branch length\n");
     treeEchoContext(fp, 40);
     REprintf("\n");
     return  FALSE;
   }
 
+  fp->pos += numberEnd - number;
+
   return  TRUE;
 }
 
 
-static int treeFlushLen (FILE  *fp)
+static int treeFlushLen (TreeReader *fp)
 {
   double  dummy;
   int     ch;
@@ -656,14 +724,14 @@ static int treeFlushLen (FILE  *fp)
     {
       ch = treeGetCh(fp);
 
-      ungetc(ch, fp);
+      treeUngetc(ch, fp);
       if(NOT treeProcessLength(fp, & dummy)) return 0;
       return 1;
     }
 
 
 
-  if (ch != EOF) (void) ungetc(ch, fp);
+  if (ch != EOF) treeUngetc(ch, fp);
   return 1;
 }
 
@@ -773,14 +841,14 @@ boolean whitechar (int ch)
 }
 
 
-static void  treeEchoContext (FILE *fp1, int n)
+static void  treeEchoContext (TreeReader *fp1, int n)
 { /* treeEchoContext */
   int      ch;
   boolean  waswhite;
 
   waswhite = TRUE;
 
-  while (n > 0 && ((ch = getc(fp1)) != EOF)) {
+  while (n > 0 && ((ch = treeGetc(fp1)) != EOF)) {
     if (whitechar(ch)) {
       ch = waswhite ? '\0' : ' ';
       waswhite = TRUE;
@@ -797,11 +865,11 @@ static void  treeEchoContext (FILE *fp1, int n)
 }
 
 
-int treeFinishCom (FILE *fp, char **strp)
+int treeFinishCom (TreeReader *fp, char **strp)
 {
   int  ch;
 
-  while ((ch = getc(fp)) != EOF && ch != ']') {
+  while ((ch = treeGetc(fp)) != EOF && ch != ']') {
     if (strp != NULL) *(*strp)++ = ch;    /* save character  */
     if (ch == '[') {                      /* nested comment; find its end */
       if ((ch = treeFinishCom(fp, strp)) == EOF)  break;
@@ -814,11 +882,11 @@ int treeFinishCom (FILE *fp, char **strp)
 }
 
 
-static int treeGetCh (FILE *fp)
+static int treeGetCh (TreeReader *fp)
 {
   int  ch;
 
-  while ((ch = getc(fp)) != EOF) {
+  while ((ch = treeGetc(fp)) != EOF) {
     if (whitechar(ch)) ;
     else if (ch == '[') {                   /* comment; find its end */
       if ((ch = treeFinishCom(fp, (char **) NULL)) == EOF)  break;
@@ -830,7 +898,7 @@ static int treeGetCh (FILE *fp)
 }
 
 
-static boolean treeNeedCh (FILE *fp, int c1, char *where)
+static boolean treeNeedCh (TreeReader *fp, int c1, char *where)
 {
   int c2;
 
@@ -843,7 +911,7 @@ static boolean treeNeedCh (FILE *fp, int c1, char *where)
     }
   else
     {
-      ungetc(c2, fp);
+      treeUngetc(c2, fp);
       treeEchoContext(fp, 40);
     }
   REprintf("\n");
@@ -855,7 +923,7 @@ static boolean treeNeedCh (FILE *fp, int c1, char *where)
 }
 
 
-static boolean addElementLen (FILE *fp, All *tr, nodeptr p, boolean readBranchLengths, boolean readNodeLabels, int *lcount)
+static boolean addElementLen (TreeReader *fp, All *tr, nodeptr p, boolean readBranchLengths, boolean readNodeLabels, int *lcount)
 {
   nodeptr  q;
   int      n, ch, fres;
@@ -909,7 +977,7 @@ static boolean addElementLen (FILE *fp, All *tr, nodeptr p, boolean readBranchLe
     }
   else
     {
-      ungetc(ch, fp);
+      treeUngetc(ch, fp);
       if ((n = treeFindTipName(fp, tr)) <= 0)          return FALSE;
       q = tr->nodep[n];
       if (tr->start->number > n)  tr->start = q;
@@ -953,7 +1021,7 @@ int getTreeStringLength(char *fileName)
 }
 
 
-int treeReadLen (FILE *fp, All *tr,
+int treeReadLen (TreeReader *fp, All *tr,
          boolean readBranches, boolean readNodeLabels,
          boolean topologyOnly, boolean completeTree)
 {
@@ -1004,7 +1072,13 @@ int treeReadLen (FILE *fp, All *tr,
 
   p = tr->nodep[(tr->nextnode)++];
 
-  while((ch = treeGetCh(fp)) != '(');
+  while((ch = treeGetCh(fp)) != '(')
+    if(ch == EOF)
+      {
+        REprintf("ERROR: Expecting a tree, found End-of-File\n");
+        assert(0);
+        return lcount;
+      }
 
   if(NOT topologyOnly)
     assert(readBranches == FALSE && readNodeLabels == FALSE);
@@ -1026,7 +1100,7 @@ int treeReadLen (FILE *fp, All *tr,
       else
     {                                    /*  A rooted format */
       tr->rooted = TRUE;
-      if (ch != EOF)  (void) ungetc(ch, fp);
+      if (ch != EOF)  treeUngetc(ch, fp);
     }
     }
   else
@@ -1094,234 +1168,782 @@ void getxnode (nodeptr p)
 }
 
 
-entry *initEntry(void)
+static void insertHashAll(uint32_t *bitVector, hashtable *h, int treeNumber, uint64_t hash)
 {
-  entry *e = (entry*)CALLOC(1,sizeof(entry));
-
-  e->bitVector     = (uint32_t*)NULL;
-  e->treeVector    = (uint32_t*)NULL;
-  e->supportVector = (int*)NULL;
-  e->bipNumber  = 0;
-  e->bipNumber2 = 0;
-  e->supportFromTreeset[0] = 0;
-  e->supportFromTreeset[1] = 0;
-  e->next       = (entry*)NULL;
-
-  return e;
+  boolean
+    inserted;
+
+  uint32_t
+    e = findOrInsertEntry(h, bitVector, hash, &inserted);
+
+  if(treeNumber == 0)
+    h->bipNumbers[e]++;
+  else
+    h->bipNumbers2[e]++;
 }
 
 
-static void insertHashAll(uint32_t *bitVector, hashtable *h, uint32_t vectorLength, int treeNumber,  uint32_t position)
+static void insertHash(uint32_t *bitVector, hashtable *h, int bipNumber, uint64_t hash)
 {
-  if(h->table[position] != NULL)
-    {
-      entry *e = h->table[position];
+  boolean
+    inserted;
+
+  uint32_t
+    e = findOrInsertEntry(h, bitVector, hash, &inserted);
+
+  assert(inserted);
+
+  h->bipNumbers[e] = bipNumber;
+}
+
+
+static int countHash(uint32_t *bitVector, hashtable *h, uint64_t hash)
+{
+  int
+    e = findEntry(h, bitVector, hash);
+
+  return e < 0 ? -1 : (int)h->bipNumbers[e];
+}
+
+
+static void insertHashBootstop(uint32_t *bitVector, hashtable *h, int treeNumber, uint64_t hash)
+{
+  boolean
+    inserted;
+
+  uint32_t
+    e = findOrInsertEntry(h, bitVector, hash, &inserted);
+
+  if(inserted)
+    h->bipNumbers[e] = e;
+
+  addTreeToSet(GET_ENTRY_TREESET(h, e), treeNumber, h->treeVectorLength);
+}
 
-      do
+
+static char *readWholeFile(const char *fileName, size_t *length)
+{
+  FILE
+    *f = myfopen(fileName, "rb");
+
+  size_t
+    capacity = 1 << 16,
+    numRead;
+
+  char
+    *result = malloc(capacity);
+
+  *length = 0;
+
+  while((numRead = fread(result + *length, sizeof(char), capacity - *length, f)) > 0)
     {
-      uint32_t i;
+      *length += numRead;
+      if(*length == capacity)
+        {
+          capacity *= 2;
+          result = realloc(result, capacity);
+        }
+    }
 
-      for(i = 0; i < vectorLength; i++)
-        if(bitVector[i] != e->bitVector[i])
-          break;
+  fclose(f);
+
+  return result;
+}
 
-      if(i == vectorLength)
+
+/* remembers where each tree starts. Trees are delimited by ';', the
+   scan is done with memchr */
+static void indexTrees(TreeFile *treeFile)
+{
+  size_t
+    capacity = 1024;
+
+  const char
+    *iter,
+    *end;
+
+  treeFile->numberOfTrees = 0;
+  treeFile->treeOffsets = malloc(capacity * sizeof(size_t));
+  treeFile->treeOffsets[0] = 0;
+
+  end = treeFile->buffer + treeFile->length;
+  for(iter = treeFile->buffer;
+      iter < end && (iter = memchr(iter, ';', end - iter));
+      ++iter)
+    {
+      if((size_t)treeFile->numberOfTrees + 2 > capacity)
         {
-          if(treeNumber == 0)
-        e->bipNumber =     e->bipNumber  + 1;
-          else
-        e->bipNumber2 = e->bipNumber2 + 1;
-          return;
+          capacity *= 2;
+          treeFile->treeOffsets = realloc(treeFile->treeOffsets, capacity * sizeof(size_t));
         }
 
-      e = e->next;
+      treeFile->numberOfTrees++;
+      treeFile->treeOffsets[treeFile->numberOfTrees] = (iter - treeFile->buffer) + 1;
     }
-      while(e != (entry*)NULL);
+}
 
-      e = initEntry();
 
-      e->bitVector  = (uint32_t*)CALLOC(vectorLength, sizeof(uint32_t));
-      /* e->bitVector = (uint32_t*)malloc_aligned(vectorLength * sizeof(uint32_t)); */
-      memset(e->bitVector, 0, vectorLength * sizeof(uint32_t));
+/* gzip and zstd files start with a magic number, their contents
+   cannot be parsed as Newick */
+static boolean isCompressed(const TreeFile *treeFile)
+{
+  const unsigned char
+    *bytes = (const unsigned char*)treeFile->buffer;
 
+  if(treeFile->length > 1 && bytes[0] == 0x1f && bytes[1] == 0x8b)
+    return TRUE;
 
-      memcpy(e->bitVector, bitVector, sizeof(uint32_t) * vectorLength);
+  if(treeFile->length > 3 && bytes[0] == 0x28 && bytes[1] == 0xb5 && bytes[2] == 0x2f && bytes[3] == 0xfd)
+    return TRUE;
+
+  return FALSE;
+}
 
-      if(treeNumber == 0)
-    e->bipNumber  = 1;
-      else
-    e->bipNumber2 = 1;
 
-      e->next = h->table[position];
-      h->table[position] = e;
+/* maps the tree file into memory and indexes the trees it contains.
+   Returns NULL, if the file is compressed. */
+TreeFile *openTreeFile(const char *fileName)
+{
+  TreeFile
+    *result = CALLOC(1, sizeof(TreeFile));
+
+#ifndef WIN32
+  int
+    fd = open(fileName, O_RDONLY);
+
+  struct stat
+    fileInfo;
+
+  if(fd >= 0 && fstat(fd, &fileInfo) == 0 && fileInfo.st_size > 0)
+    {
+      void
+        *mapped = mmap(NULL, fileInfo.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+      if(mapped != MAP_FAILED)
+        {
+#ifdef MADV_SEQUENTIAL
+          madvise(mapped, fileInfo.st_size, MADV_SEQUENTIAL);
+#endif
+          result->buffer = mapped;
+          result->length = fileInfo.st_size;
+          result->isMapped = TRUE;
+        }
     }
-  else
+
+  if(fd >= 0)
+    close(fd);
+#endif
+
+  if(NOT result->isMapped)
+    result->buffer = readWholeFile(fileName, &(result->length));
+
+  result->name = strdup(fileName);
+
+  if(isCompressed(result))
     {
-      entry *e = initEntry();
+      REprintf("ERROR: %s is compressed, please decompress it first.\n", fileName);
+      closeTreeFile(result);
+      return (TreeFile*)NULL;
+    }
 
-      e->bitVector  = (uint32_t*)CALLOC(vectorLength, sizeof(uint32_t));
-      /* e->bitVector = (uint32_t*)malloc_aligned(vectorLength * sizeof(uint32_t)); */
-      memset(e->bitVector, 0, vectorLength * sizeof(uint32_t));
+  indexTrees(result);
 
-      memcpy(e->bitVector, bitVector, sizeof(uint32_t) * vectorLength);
+  return result;
+}
 
-      if(treeNumber == 0)
-    e->bipNumber  = 1;
-      else
-    e->bipNumber2 = 1;
 
-      h->table[position] = e;
+static void appendToTreeFile(TreeFile *treeFile, size_t *capacity, const char *str, size_t length)
+{
+  if(treeFile->length + length > *capacity)
+    {
+      while(treeFile->length + length > *capacity)
+        *capacity *= 2;
+      treeFile->buffer = realloc(treeFile->buffer, *capacity);
     }
 
-  h->entryCount =  h->entryCount + 1;
+  memcpy(treeFile->buffer + treeFile->length, str, length);
+  treeFile->length += length;
 }
 
 
-static void insertHash(uint32_t *bitVector, hashtable *h, uint32_t vectorLength, int bipNumber, uint32_t position)
+/* collects Newick strings that are already in memory (e.g., handed
+   over from R). A missing ';' after the last tree of a string is
+   added. */
+TreeFile *createTreeFileFromStrings(const char * const *trees, int numberOfStrings)
 {
-  entry *e = initEntry();
+  TreeFile
+    *result = CALLOC(1, sizeof(TreeFile));
 
-  e->bipNumber = bipNumber;
-  /*e->bitVector = (uint32_t*)CALLOC(vectorLength, sizeof(uint32_t)); */
+  size_t
+    capacity = 1024;
 
-  e->bitVector = (uint32_t*)CALLOC(vectorLength , sizeof(uint32_t));
-  memset(e->bitVector, 0, vectorLength * sizeof(uint32_t));
+  int
+    i;
 
-  memcpy(e->bitVector, bitVector, sizeof(uint32_t) * vectorLength);
+  result->buffer = malloc(capacity);
 
-  if(h->table[position] != NULL)
+  FOR_0_LIMIT(i, numberOfStrings)
     {
-      e->next = h->table[position];
-      h->table[position] = e;
+      size_t
+        length = strlen(trees[i]),
+        end = length;
+
+      while(end > 0 && whitechar(trees[i][end - 1]))
+        end--;
+
+      appendToTreeFile(result, &capacity, trees[i], length);
+      if(end > 0 && trees[i][end - 1] != ';')
+        appendToTreeFile(result, &capacity, ";", 1);
+      appendToTreeFile(result, &capacity, "\n", 1);
     }
-  else
-    h->table[position] = e;
 
-  h->entryCount =  h->entryCount + 1;
+  result->name = strdup("(in memory)");
+  indexTrees(result);
+
+  return result;
 }
 
 
-static int countHash(uint32_t *bitVector, hashtable *h, uint32_t vectorLength, uint32_t position)
+static void appendLabel(TreeFile *treeFile, size_t *capacity, const char *label)
 {
-  if(h->table[position] == NULL)
-    return -1;
-  {
-    entry *e = h->table[position];
+  const char
+    *iter;
 
-    do
-      {
-    uint32_t i;
+  if(NOT label[strcspn(label, " \t\n\r,():;[]'")])
+    {
+      appendToTreeFile(treeFile, capacity, label, strlen(label));
+      return;
+    }
 
-    for(i = 0; i < vectorLength; i++)
-      if(bitVector[i] != e->bitVector[i])
-        goto NEXT;
+  appendToTreeFile(treeFile, capacity, "'", 1);
+  for(iter = label; *iter; ++iter)
+    {
+      if(*iter == '\'')
+        appendToTreeFile(treeFile, capacity, "'", 1);
+      appendToTreeFile(treeFile, capacity, iter, 1);
+    }
+  appendToTreeFile(treeFile, capacity, "'", 1);
+}
 
-    return (e->bipNumber);
-      NEXT:
-    e = e->next;
-      }
-    while(e != (entry*)NULL);
 
-    return -1;
-  }
+/* writes trees given as edge matrices (as in ape's phylo objects:
+   column-major, numberOfEdges rows of parent and child, tips are
+   numbered 1..numberOfTips) as Newick strings, such that they can be
+   processed like trees read from a file. Returns NULL, if an edge
+   matrix does not describe a tree. */
+TreeFile *createTreeFileFromEdges(const int * const *edges, const int *numberOfEdges, int numberOfTrees,
+                                  const char * const *tipLabels, int numberOfTips)
+{
+  TreeFile
+    *result = CALLOC(1, sizeof(TreeFile));
+
+  size_t
+    capacity = 1024;
+
+  int
+    i,
+    j,
+    t,
+    maxNodes = numberOfTips + 1,
+    *childOffsets,
+    *children,
+    *isChild,
+    *stackNode,
+    *stackChild;
+
+  result->buffer = malloc(capacity);
+
+  FOR_0_LIMIT(t, numberOfTrees)
+    maxNodes = MAX(maxNodes, numberOfEdges[t] + 2);
+
+  childOffsets = CALLOC(maxNodes + 2, sizeof(int));
+  children = CALLOC(maxNodes, sizeof(int));
+  isChild = CALLOC(maxNodes + 1, sizeof(int));
+  stackNode = CALLOC(maxNodes, sizeof(int));
+  stackChild = CALLOC(maxNodes, sizeof(int));
+
+  FOR_0_LIMIT(t, numberOfTrees)
+    {
+      const int
+        *parent = edges[t],
+        *child = edges[t] + numberOfEdges[t];
+
+      int
+        n = numberOfEdges[t],
+        numberOfNodes = n + 1,
+        root = 0,
+        depth;
+
+      memset(childOffsets, 0, (numberOfNodes + 2) * sizeof(int));
+      memset(isChild, 0, (numberOfNodes + 1) * sizeof(int));
+
+      FOR_0_LIMIT(i, n)
+        {
+          if(parent[i] < 1 || parent[i] > numberOfNodes || child[i] < 1 || child[i] > numberOfNodes
+             || parent[i] <= numberOfTips || isChild[child[i]])
+            {
+              REprintf("ERROR: edge matrix of tree %d does not describe a tree\n", t + 1);
+              goto fail;
+            }
+          isChild[child[i]] = 1;
+          childOffsets[parent[i] + 1]++;
+        }
+
+      for(i = 1; i <= numberOfNodes; ++i)
+        {
+          if(NOT isChild[i])
+            {
+              if(root || i <= numberOfTips)
+                {
+                  REprintf("ERROR: edge matrix of tree %d does not describe a tree\n", t + 1);
+                  goto fail;
+                }
+              root = i;
+            }
+          childOffsets[i + 1] += childOffsets[i];
+        }
+
+      if(NOT root)
+        {
+          REprintf("ERROR: edge matrix of tree %d does not describe a tree\n", t + 1);
+          goto fail;
+        }
+
+      /* fill the children of each node in the order of the edges */
+      memcpy(isChild, childOffsets, (numberOfNodes + 1) * sizeof(int));
+      FOR_0_LIMIT(i, n)
+        children[isChild[parent[i]]++] = child[i];
+
+      depth = 0;
+      stackNode[depth] = root;
+      stackChild[depth] = childOffsets[root];
+      appendToTreeFile(result, &capacity, "(", 1);
+
+      while(depth >= 0)
+        {
+          int
+            node = stackNode[depth];
+
+          if(stackChild[depth] == childOffsets[node + 1])
+            {
+              appendToTreeFile(result, &capacity, ")", 1);
+              depth--;
+              continue;
+            }
+
+          if(stackChild[depth] > childOffsets[node])
+            appendToTreeFile(result, &capacity, ",", 1);
+
+          j = children[stackChild[depth]++];
+
+          if(j <= numberOfTips)
+            appendLabel(result, &capacity, tipLabels[j - 1]);
+          else
+            {
+              appendToTreeFile(result, &capacity, "(", 1);
+              depth++;
+              stackNode[depth] = j;
+              stackChild[depth] = childOffsets[j];
+            }
+        }
+
+      appendToTreeFile(result, &capacity, ";\n", 2);
+    }
+
+  free(childOffsets);
+  free(children);
+  free(isChild);
+  free(stackNode);
+  free(stackChild);
+
+  result->name = strdup("(in memory)");
+  indexTrees(result);
+
+  return result;
+
+ fail:
+  free(childOffsets);
+  free(children);
+  free(isChild);
+  free(stackNode);
+  free(stackChild);
+  free(result->buffer);
+  free(result);
+
+  return NULL;
 }
 
 
-static void insertHashBootstop(uint32_t *bitVector, hashtable *h, uint32_t vectorLength, int treeNumber, int treeVectorLength, uint32_t position)
+void closeTreeFile(TreeFile *treeFile)
 {
-  if(h->table[position] != NULL)
-    {
-      entry *e = h->table[position];
+#ifndef WIN32
+  if(treeFile->isMapped)
+    munmap(treeFile->buffer, treeFile->length);
+  else
+#endif
+    free(treeFile->buffer);
 
-      do
+  free(treeFile->treeOffsets);
+  free(treeFile->name);
+  free(treeFile);
+}
+
+
+/* finds trees whose Newick strings are identical to the string of an
+   earlier tree (these need not be parsed again). Returns, for every
+   tree, the number of the first tree with the same string. */
+int *findIdenticalTrees(TreeFile *treeFile)
+{
+  int
+    i,
+    *result = CALLOC(treeFile->numberOfTrees, sizeof(int)),
+    *table;
+
+  uint32_t
+    tableSize = 64,
+    mask,
+    *hashes = CALLOC(treeFile->numberOfTrees, sizeof(uint32_t));
+
+  while(tableSize < 2 * (uint32_t)treeFile->numberOfTrees)
+    tableSize *= 2;
+  mask = tableSize - 1;
+  table = CALLOC(tableSize, sizeof(int));
+
+  FOR_0_LIMIT(i, treeFile->numberOfTrees)
     {
-      uint32_t i;
+      const char
+        *start = treeFile->buffer + treeFile->treeOffsets[i],
+        *end = treeFile->buffer + treeFile->treeOffsets[i + 1],
+        *iter;
 
-      for(i = 0; i < vectorLength; i++)
-        if(bitVector[i] != e->bitVector[i])
-          break;
+      uint32_t
+        hash = 2166136261U,
+        position;
+
+      while(start < end && isspace((unsigned char)*start))
+        start++;
 
-      if(i == vectorLength)
+      for(iter = start; iter < end; ++iter)
+        hash = (hash ^ (unsigned char)*iter) * 16777619U;
+      hashes[i] = hash;
+
+      result[i] = i;
+
+      /* table entries are tree numbers + 1 */
+      for(position = hash & mask; table[position]; position = (position + 1) & mask)
         {
-          e->treeVector[treeNumber / MASK_LENGTH] |= mask32[treeNumber % MASK_LENGTH];
-          return;
+          int
+            other = table[position] - 1;
+
+          const char
+            *otherStart = treeFile->buffer + treeFile->treeOffsets[other],
+            *otherEnd = treeFile->buffer + treeFile->treeOffsets[other + 1];
+
+          if(hashes[other] != hash)
+            continue;
+
+          while(otherStart < otherEnd && isspace((unsigned char)*otherStart))
+            otherStart++;
+
+          if(otherEnd - otherStart == end - start && memcmp(start, otherStart, end - start) == 0)
+            {
+              result[i] = other;
+              break;
+            }
         }
 
-      e = e->next;
+      if(result[i] == i)
+        table[position] = i + 1;
     }
-      while(e != (entry*)NULL);
 
-      e = initEntry();
+  free(table);
+  free(hashes);
 
-      e->bipNumber = h->entryCount;
+  return result;
+}
 
-      /*e->bitVector  = (uint32_t*)CALLOC(vectorLength, sizeof(uint32_t));*/
-      e->bitVector = (uint32_t*)CALLOC(vectorLength, sizeof(uint32_t));
-      memset(e->bitVector, 0, vectorLength * sizeof(uint32_t));
 
+static void initTreeReader(TreeReader *reader, TreeFile *file, int treeNumber)
+{
+  assert(treeNumber < file->numberOfTrees);
 
-      e->treeVector = (uint32_t*)CALLOC(treeVectorLength, sizeof(uint32_t));
+  reader->pos = file->buffer + file->treeOffsets[treeNumber];
+  reader->end = file->buffer + file->treeOffsets[treeNumber + 1];
+}
 
-      e->treeVector[treeNumber / MASK_LENGTH] |= mask32[treeNumber % MASK_LENGTH];
-      memcpy(e->bitVector, bitVector, sizeof(uint32_t) * vectorLength);
 
-      e->next = h->table[position];
-      h->table[position] = e;
-    }
-  else
+static void readTreeFromFile(All *tr, TreeFile *file, int treeNumber)
+{
+  TreeReader
+    reader;
+
+  initTreeReader(&reader, file, treeNumber);
+
+  treeReadLen(&reader, tr, FALSE, FALSE, TRUE, TRUE);
+}
+
+
+/* trees of a collection usually list their taxa in the same order.
+   Thus, the label is compared to the taxon found at the same position
+   of the previous tree first and only looked up if it differs. */
+static int findTipAtPosition(SplitExtractor *ex, All *tr, TreeReader *fp, int position)
+{
+  char
+    str[nmlngth + 2];
+
+  int
+    n;
+
+  if(NOT treeGetLabel(fp, str, nmlngth + 2))
+    return 0;
+
+  if(position < ex->mxtips)
     {
-      entry *e = initEntry();
+      n = ex->tipAtPosition[position];
+      if(n > 0 && strcmp(str, tr->nameList[n]) == 0)
+        return n;
+    }
 
-      e->bipNumber = h->entryCount;
+  n = treeFindTipByLabelString(str, tr);
 
-      e->bitVector = (uint32_t*)CALLOC(vectorLength , sizeof(uint32_t));
-      memset(e->bitVector, 0, vectorLength * sizeof(uint32_t));
+  if(position < ex->mxtips)
+    ex->tipAtPosition[position] = n;
+
+  return n;
+}
 
-      e->treeVector = (uint32_t*)CALLOC(treeVectorLength, sizeof(uint32_t));
 
-      e->treeVector[treeNumber / MASK_LENGTH] |= mask32[treeNumber % MASK_LENGTH];
-      memcpy(e->bitVector, bitVector, sizeof(uint32_t) * vectorLength);
+SplitExtractor *createSplitExtractor(All *tr, int referenceTip)
+{
+  SplitExtractor
+    *result = CALLOC(1, sizeof(SplitExtractor));
+
+  int
+    i;
 
-      h->table[position] = e;
+  assert(referenceTip > 0 && referenceTip <= tr->mxtips);
+
+  result->mxtips = tr->mxtips;
+  result->referenceTip = referenceTip;
+  result->vectorLength = GET_BITVECTOR_LENGTH(tr->mxtips);
+
+  result->tipHashes = CALLOC(tr->mxtips + 1, sizeof(uint64_t));
+  for(i = 1; i <= tr->mxtips; ++i)
+    {
+      result->tipHashes[i] = tr->nodep[i]->hash;
+      result->totalHash ^= tr->nodep[i]->hash;
     }
 
-  h->entryCount =  h->entryCount + 1;
+  /* a clade is opened per '(', unary nodes aside there are at most
+     mxtips - 1 of them */
+  result->maxDepth = tr->mxtips + 1;
+  result->clades = CALLOC(result->maxDepth * result->vectorLength, sizeof(BitVector));
+  result->cladeHashes = CALLOC(result->maxDepth, sizeof(uint64_t));
+  result->cladeSizes = CALLOC(result->maxDepth, sizeof(int));
+  result->tipAtPosition = CALLOC(tr->mxtips, sizeof(int));
+
+  /* the clades of a tree form a hierarchy, thus there are less than
+     2 * mxtips distinct ones */
+  result->maxSplits = 2 * tr->mxtips;
+  result->splits = CALLOC((size_t)result->maxSplits * result->vectorLength, sizeof(BitVector));
+  result->splitHashes = CALLOC(result->maxSplits, sizeof(uint64_t));
+  result->splitSlotMask = 64;
+  while(result->splitSlotMask < 2 * (uint32_t)result->maxSplits)
+    result->splitSlotMask *= 2;
+  result->splitSlots = CALLOC(result->splitSlotMask, sizeof(uint32_t));
+  result->splitSlotMask--;
+
+  result->validBits = (tr->mxtips % MASK_LENGTH)
+    ? (mask32[tr->mxtips % MASK_LENGTH] - 1)
+    : ~ (BitVector)0;
+
+  return result;
 }
 
 
-FILE *getNumberOfTrees(All *tr, const char *fileName)
+void freeSplitExtractor(SplitExtractor *ex)
 {
-  FILE
-    *f = myfopen(fileName, "r");
+  free(ex->tipHashes);
+  free(ex->clades);
+  free(ex->cladeHashes);
+  free(ex->cladeSizes);
+  free(ex->tipAtPosition);
+  free(ex->splits);
+  free(ex->splitHashes);
+  free(ex->splitSlots);
+  free(ex);
+}
+
+
+/* appends the split of clade to the splits of the tree, unless the
+   tree already has it (the two clades below a bifurcating root and
+   the clades of unary nodes repeat a split) */
+static void addCladeSplit(SplitExtractor *ex, BitVector *clade, uint64_t hash)
+{
+  uint32_t
+    i,
+    position;
+
+  BitVector
+    *split = ex->splits + (size_t)ex->numberOfSplits * ex->vectorLength;
+
+  if(NTH_BIT_IS_SET(clade, ex->referenceTip - 1))
+    {
+      FOR_0_LIMIT(i, ex->vectorLength)
+        split[i] = ~ clade[i];
+      split[ex->vectorLength - 1] &= ex->validBits;
+      hash ^= ex->totalHash;
+    }
+  else
+    memcpy(split, clade, ex->vectorLength * sizeof(BitVector));
+
+  for(position = hash & ex->splitSlotMask; ex->splitSlots[position]; position = (position + 1) & ex->splitSlotMask)
+    {
+      uint32_t
+        other = ex->splitSlots[position] - 1;
 
+      if(ex->splitHashes[other] == hash
+         && NOT memcmp(ex->splits + (size_t)other * ex->vectorLength, split, ex->vectorLength * sizeof(BitVector)))
+        return;
+    }
+
+  assert(ex->numberOfSplits < ex->maxSplits);
+  ex->splitSlots[position] = ex->numberOfSplits + 1;
+  ex->splitHashes[ex->numberOfSplits++] = hash;
+}
+
+
+/* collects the taxa of every clade on a stack while tokenizing the
+   Newick string and lists the distinct non-trivial splits in ex, in
+   the order their clades close; no node structure is built, thus
+   multifurcations and rooted trees need no special treatment (the two
+   clades below a bifurcating root map onto the same split). */
+static void extractSplits(SplitExtractor *ex, All *tr, TreeReader *fp, int treeNumber)
+{
   int
-    trees = 0,
-    ch;
+    ch,
+    n,
+    depth = 0,
+    numberOfTips = 0;
 
-  while((ch = fgetc(f)) != EOF)
-    if(ch == ';')
-      trees++;
+  BitVector
+    *clade;
 
-  assert(trees > 0);
+  while((ch = treeGetCh(fp)) != '(')
+    if(ch == EOF)
+      {
+        REprintf("ERROR: Expecting a tree, found End-of-File\n");
+        assert(0);
+        return;
+      }
 
-  tr->numberOfTrees = trees;
+  memset(ex->splitSlots, 0, (ex->splitSlotMask + 1) * sizeof(uint32_t));
+  ex->numberOfSplits = 0;
 
-  rewind(f);
+  memset(ex->clades, 0, ex->vectorLength * sizeof(BitVector));
+  ex->cladeHashes[0] = 0;
+  ex->cladeSizes[0] = 0;
+  depth = 1;
+
+  while(depth > 0)
+    {
+      ch = treeGetCh(fp);
 
-  return f;
+      switch(ch)
+        {
+        case '(':
+          if(depth == ex->maxDepth)
+            {
+              REprintf("ERROR: Too many nested clades in tree %d\n", treeNumber + 1);
+              assert(0);
+            }
+          memset(ex->clades + depth * ex->vectorLength, 0, ex->vectorLength * sizeof(BitVector));
+          ex->cladeHashes[depth] = 0;
+          ex->cladeSizes[depth] = 0;
+          depth++;
+          break;
+        case ',':
+          break;
+        case ')':
+          depth--;
+          (void) treeFlushLabel(fp);
+          if(NOT treeFlushLen(fp))
+            assert(0);
+
+          if(depth > 0)
+            {
+              BitVector
+                *parent = ex->clades + (depth - 1) * ex->vectorLength;
+              uint32_t
+                i;
+
+              clade = ex->clades + depth * ex->vectorLength;
+
+              FOR_0_LIMIT(i, ex->vectorLength)
+                parent[i] |= clade[i];
+              ex->cladeHashes[depth - 1] ^= ex->cladeHashes[depth];
+              ex->cladeSizes[depth - 1] += ex->cladeSizes[depth];
+
+              if(ex->cladeSizes[depth] > 1 && ex->cladeSizes[depth] < ex->mxtips - 1)
+                addCladeSplit(ex, clade, ex->cladeHashes[depth]);
+            }
+          break;
+        case EOF:
+        case ';':
+          REprintf("ERROR: Unexpected end of tree %d\n", treeNumber + 1);
+          assert(0);
+          return;
+        default:
+          treeUngetc(ch, fp);
+          if((n = findTipAtPosition(ex, tr, fp, numberOfTips)) <= 0)
+            assert(0);
+          clade = ex->clades + (depth - 1) * ex->vectorLength;
+          FLIP_NTH_BIT(clade, n - 1);
+          ex->cladeHashes[depth - 1] ^= ex->tipHashes[n];
+          ex->cladeSizes[depth - 1]++;
+          numberOfTips++;
+          if(NOT treeFlushLen(fp))
+            assert(0);
+          break;
+        }
+    }
+
+  if (NOT treeNeedCh(fp, ';', "at end of"))
+    assert(0);
+
+  if(numberOfTips != ex->mxtips
+     || genericBitCount(ex->clades, ex->vectorLength) != (uint32_t)ex->mxtips)
+    {
+      printBothOpen("The RogueNaRok option you are using requires to read in only complete trees\n");
+      printBothOpen("with %d taxa, tree %d has %d taxa though ... exiting\n", ex->mxtips, treeNumber + 1, numberOfTips);
+      assert(0);
+    }
 }
 
 
 /* INTERFACE TO OUTSIDE WOLRD */
-void readBestTree(All *tr, FILE *file)
+/* branch lengths of the best tree are optional, they are not used */
+void readBestTree(All *tr, TreeFile *file)
+{
+  readTreeFromFile(tr, file, 0);
+}
+
+
+void readBootstrapTree(All *tr, TreeFile *file, int treeNumber)
 {
-  treeReadLen(file, tr, TRUE, FALSE, TRUE,  TRUE);
+  readTreeFromFile(tr, file, treeNumber);
 }
 
 
-void readBootstrapTree(All *tr, FILE *file)
+/* lists the distinct non-trivial splits of the tree in ex */
+void readBootstrapSplits(SplitExtractor *ex, All *tr, TreeFile *file, int treeNumber)
 {
-  treeReadLen(file, tr, FALSE, FALSE, TRUE, TRUE);
+  TreeReader
+    reader;
+
+  initTreeReader(&reader, file, treeNumber);
+
+  extractSplits(ex, tr, &reader, treeNumber);
 }
 
 void freeTree(All *tr)
@@ -1331,24 +1953,16 @@ void freeTree(All *tr)
     free(tr->nameList[i]);
   free(tr->nameList);
 
-  for(i = 0; i < tr->nameHash->tableSize; ++i)
-    {
-      stringEntry *elem = tr->nameHash->table[i];
-      while(elem)
-    {
-      stringEntry *iter = elem->next;
-      free(elem->word);
-      free(elem);
-      elem = iter;
-    }
-    }
-  free(tr->nameHash->table);
-  free(tr->nameHash);
-  /* FOR_0_LIMIT(i,((tr->mxtips-1) )) */
-  /*   free(tr->nodep[i]); */
+  freeStringHashTable(tr->nameHash);
+  if(tr->p0)
+    FOR_0_LIMIT(i, tr->mxtips + 3 * (tr->mxtips - 1))
+      if(tr->p0[i].z)
+        free(tr->p0[i].z);
   free(tr->nodep);
   free(tr->p0);
+  free(tr->treeWeights);
 
   free(tr);
 }
+
 /* END OF INTERFACE */
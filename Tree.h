@@ -43,17 +43,62 @@
 
 extern uint32_t *mask32;
 
+typedef struct
+{
+  char *name;                   /* file name, for messages */
+  char *buffer;                 /* content of the tree file (mapped, if possible) */
+  size_t length;
+  size_t *treeOffsets;          /* tree i spans [treeOffsets[i], treeOffsets[i+1]) */
+  int numberOfTrees;
+  boolean isMapped;
+} TreeFile;
+
+typedef struct
+{
+  const char *pos;
+  const char *end;
+} TreeReader;
+
+typedef struct
+{
+  int mxtips;
+  int referenceTip;             /* splits are oriented away from this taxon */
+  uint32_t vectorLength;
+  uint64_t *tipHashes;
+  uint64_t totalHash;
+  BitVector validBits;          /* bits of the last word that belong to taxa */
+  int maxDepth;
+  BitVector *clades;            /* stack of open clades */
+  uint64_t *cladeHashes;
+  int *cladeSizes;
+  int *tipAtPosition;           /* taxon at each tip position of the last tree */
+  int maxSplits;
+  int numberOfSplits;
+  BitVector *splits;            /* the distinct splits of the last tree */
+  uint64_t *splitHashes;
+  uint32_t *splitSlots;         /* open addressing over splits, entries are indices + 1 */
+  uint32_t splitSlotMask;
+} SplitExtractor;
+
 boolean isTip(int number, int maxTips);
 char *writeTreeToString(All *tr, boolean printBranchLengths);
 void readTree(char *fileName);
-boolean setupTree (All *tr, const char *bootstrapTrees);
-void readBestTree(All *tr, FILE *file);  
-void readBootstrapTree(All *tr, FILE *file);
+boolean setupTree (All *tr, TreeFile *bootstrapTrees);
+void readBestTree(All *tr, TreeFile *file);
+void readBootstrapTree(All *tr, TreeFile *file, int treeNumber);
+SplitExtractor *createSplitExtractor(All *tr, int referenceTip);
+void freeSplitExtractor(SplitExtractor *ex);
+void readBootstrapSplits(SplitExtractor *ex, All *tr, TreeFile *file, int treeNumber);
 void hookupDefault (nodeptr p, nodeptr q, int numBranches);
 void hookupAdd (nodeptr p, nodeptr q, int numBranches);
 nodeptr findAnyTip(nodeptr p, int numsp);
 int treeFindTipByLabelString(char  *str, All *tr);
 int getTreeStringLength(char *fileName);
-FILE *getNumberOfTrees(All *tr, const char *fileName);
+TreeFile *openTreeFile(const char *fileName);
+TreeFile *createTreeFileFromStrings(const char * const *trees, int numberOfStrings);
+TreeFile *createTreeFileFromEdges(const int * const *edges, const int *numberOfEdges, int numberOfTrees,
+                                  const char * const *tipLabels, int numberOfTips);
+void closeTreeFile(TreeFile *treeFile);
+int *findIdenticalTrees(TreeFile *treeFile);
 void freeTree(All *tr);
 #endif
@@ -0,0 +1,401 @@
+/*  RogueNaRok is an algorithm for the identification of rogue taxa in a set of phylogenetic trees. 
+ *
+ *  Moreover, the program collection comes with efficient implementations of 
+ *   * the unrooted leaf stability by Thorley and Wilkinson
+ *   * the taxonomic instability index by Maddinson and Maddison
+ *   * a maximum agreement subtree implementation (MAST) for unrooted trees 
+ *   * a tool for pruning taxa from a tree collection. 
+ * 
+ *  Copyright October 2011 by Andre J. Aberer
+ * 
+ *  Tree I/O and parallel framework are derived from RAxML by Alexandros Stamatakis.
+ *
+ *  This program is free software; you may redistribute it and/or
+ *  modify its under the terms of the GNU General Public License as
+ *  published by the Free Software Foundation; either version 2 of the
+ *  License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  For any other inquiries send an Email to Andre J. Aberer
+ *  andre.aberer at googlemail.com
+ * 
+ *  When publishing work that is based on the results from RogueNaRok, please cite:
+ *  Andre J. Aberer, Denis Krompaß, Alexandros Stamatakis. RogueNaRok: an Efficient and Exact Algorithm for Rogue Taxon Identification. (unpublished) 2011. 
+ * 
+ */
+
+#include "TreeSet.h"
+
+#define IS_SPARSE(cardinality, treeVectorLength) ((cardinality) < (uint32_t)(treeVectorLength))
+
+
+static void makeDense(TreeSet *set, int treeVectorLength)
+{
+  uint32_t
+    i;
+
+  BitVector
+    *bitmap = CALLOC(treeVectorLength, sizeof(BitVector));
+
+  FOR_0_LIMIT(i, set->cardinality)
+    FLIP_NTH_BIT(bitmap, set->trees[i]);
+
+  free(set->trees);
+  set->trees = NULL;
+  set->capacity = 0;
+  set->bitmap = bitmap;
+}
+
+
+/* the set of the first numberOfTrees bits of bitVector */
+void initTreeSet(TreeSet *set, const BitVector *bitVector, int numberOfTrees)
+{
+  int
+    i,
+    treeVectorLength = GET_BITVECTOR_LENGTH(numberOfTrees);
+
+  memset(set, 0, sizeof(TreeSet));
+
+  FOR_0_LIMIT(i, numberOfTrees)
+    if(NTH_BIT_IS_SET(bitVector, i))
+      set->cardinality++;
+
+  if(IS_SPARSE(set->cardinality, treeVectorLength))
+    {
+      uint32_t
+        j = 0;
+
+      set->capacity = MAX(set->cardinality, 1);
+      set->trees = CALLOC(set->capacity, sizeof(uint32_t));
+      FOR_0_LIMIT(i, numberOfTrees)
+        if(NTH_BIT_IS_SET(bitVector, i))
+          set->trees[j++] = i;
+    }
+  else
+    {
+      set->bitmap = CALLOC(treeVectorLength, sizeof(BitVector));
+      FOR_0_LIMIT(i, numberOfTrees)
+        if(NTH_BIT_IS_SET(bitVector, i))
+          FLIP_NTH_BIT(set->bitmap, i);
+    }
+}
+
+
+void freeTreeSet(TreeSet *set)
+{
+  free(set->trees);
+  free(set->bitmap);
+  memset(set, 0, sizeof(TreeSet));
+}
+
+
+/* adds tree to the set. Trees are added in ascending order (as they
+   are read), thus an array grows at its end. */
+void addTreeToSet(TreeSet *set, uint32_t tree, int treeVectorLength)
+{
+  if(set->bitmap)
+    {
+      if(NOT NTH_BIT_IS_SET(set->bitmap, tree))
+        {
+          FLIP_NTH_BIT(set->bitmap, tree);
+          set->cardinality++;
+        }
+      return;
+    }
+
+  if(set->cardinality && set->trees[set->cardinality - 1] == tree)
+    return;
+  assert(NOT set->cardinality || set->trees[set->cardinality - 1] < tree);
+
+  if(set->cardinality == set->capacity)
+    {
+      set->capacity = MAX(2 * set->capacity, 1);
+      set->trees = realloc(set->trees, set->capacity * sizeof(uint32_t));
+    }
+  set->trees[set->cardinality++] = tree;
+
+  if(NOT IS_SPARSE(set->cardinality, treeVectorLength))
+    makeDense(set, treeVectorLength);
+}
+
+
+boolean isTreeInSet(const TreeSet *set, uint32_t tree)
+{
+  uint32_t
+    low = 0,
+    high = set->cardinality;
+
+  if(set->bitmap)
+    return NTH_BIT_IS_SET(set->bitmap, tree) ? TRUE : FALSE;
+
+  /* the array is ascending */
+  while(low < high)
+    {
+      uint32_t
+        middle = low + (high - low) / 2;
+
+      if(set->trees[middle] < tree)
+        low = middle + 1;
+      else
+        high = middle;
+    }
+
+  return low < set->cardinality && set->trees[low] == tree;
+}
+
+
+/* returns whether tree was in the set */
+boolean removeTreeFromSet(TreeSet *set, uint32_t tree)
+{
+  uint32_t
+    i;
+
+  if(set->bitmap)
+    {
+      if(NOT NTH_BIT_IS_SET(set->bitmap, tree))
+        return FALSE;
+      UNFLIP_NTH_BIT(set->bitmap, tree);
+      set->cardinality--;
+      return TRUE;
+    }
+
+  /* usually, it is the last tree */
+  for(i = set->cardinality; i--; )
+    if(set->trees[i] == tree)
+      {
+        memmove(set->trees + i, set->trees + i + 1, (set->cardinality - i - 1) * sizeof(uint32_t));
+        set->cardinality--;
+        return TRUE;
+      }
+
+  return FALSE;
+}
+
+
+/* releases the room an array has beyond its trees */
+void trimTreeSet(TreeSet *set)
+{
+  if(set->bitmap || set->capacity == MAX(set->cardinality, 1))
+    return;
+
+  set->capacity = MAX(set->cardinality, 1);
+  set->trees = realloc(set->trees, set->capacity * sizeof(uint32_t));
+}
+
+
+void treeSetToBitVector(const TreeSet *set, BitVector *bitVector, int treeVectorLength)
+{
+  uint32_t
+    i;
+
+  memset(bitVector, 0, treeVectorLength * sizeof(BitVector));
+
+  if(set->bitmap)
+    memcpy(bitVector, set->bitmap, treeVectorLength * sizeof(BitVector));
+  else
+    FOR_0_LIMIT(i, set->cardinality)
+      FLIP_NTH_BIT(bitVector, set->trees[i]);
+}
+
+
+/* writes the trees of the set to trees (in ascending order) and
+   returns their number */
+uint32_t getTreesOfSet(const TreeSet *set, uint32_t *trees)
+{
+  uint32_t
+    i,
+    result = 0;
+
+  if(NOT set->bitmap)
+    {
+      memcpy(trees, set->trees, set->cardinality * sizeof(uint32_t));
+      return set->cardinality;
+    }
+
+  for(i = 0; result < set->cardinality; i++)
+    {
+      BitVector
+        word = set->bitmap[i];
+
+      for( ; word; word &= word - 1)
+        trees[result++] = i * MASK_LENGTH + __builtin_ctz(word);
+    }
+
+  return result;
+}
+
+
+/* set becomes the union of set and other */
+void unionTreeSet(TreeSet *set, const TreeSet *other, int treeVectorLength)
+{
+  uint32_t
+    i;
+
+  if(NOT set->bitmap && NOT other->bitmap)
+    {
+      uint32_t
+        j = 0,
+        k = 0,
+        capacity = MAX(set->cardinality + other->cardinality, 1),
+        *trees = CALLOC(capacity, sizeof(uint32_t));
+
+      /* merge the arrays */
+      i = 0;
+      while(i < set->cardinality || j < other->cardinality)
+        {
+          if(j == other->cardinality
+             || (i < set->cardinality && set->trees[i] < other->trees[j]))
+            trees[k++] = set->trees[i++];
+          else if(i == set->cardinality || other->trees[j] < set->trees[i])
+            trees[k++] = other->trees[j++];
+          else
+            {
+              trees[k++] = set->trees[i++];
+              j++;
+            }
+        }
+
+      free(set->trees);
+      set->trees = trees;
+      set->cardinality = k;
+      set->capacity = capacity;
+
+      if(NOT IS_SPARSE(set->cardinality, treeVectorLength))
+        makeDense(set, treeVectorLength);
+      return;
+    }
+
+  if(NOT set->bitmap)
+    makeDense(set, treeVectorLength);
+
+  if(other->bitmap)
+    FOR_0_LIMIT(i, (uint32_t)treeVectorLength)
+      set->bitmap[i] |= other->bitmap[i];
+  else
+    FOR_0_LIMIT(i, other->cardinality)
+      FLIP_NTH_BIT(set->bitmap, other->trees[i]);
+
+  set->cardinality = genericBitCount(set->bitmap, treeVectorLength);
+}
+
+
+/* sums up the weights of the trees. Without weights, this is the
+   number of trees. */
+int weightedTreeSetSize(const TreeSet *set, int treeVectorLength, const int *weights)
+{
+  uint32_t
+    i;
+
+  int
+    result = 0;
+
+  if(NOT weights)
+    return set->cardinality;
+
+  if(set->bitmap)
+    return weightedBitCount(set->bitmap, treeVectorLength, weights);
+
+  FOR_0_LIMIT(i, set->cardinality)
+    result += weights[set->trees[i]];
+
+  return result;
+}
+
+
+static int weightedWordSize(BitVector word, int wordIndex, const int *weights)
+{
+  int
+    result = 0;
+
+  if(NOT weights)
+    return BIT_COUNT(word);
+
+  for(; word; word &= word - 1)
+    result += weights[wordIndex * MASK_LENGTH + __builtin_ctz(word)];
+
+  return result;
+}
+
+
+/* weightedTreeSetSize of the union of the sets of the cursors, that
+   is summed up word by word without building the union. sumOfSizes is
+   the sum of the sizes of the sets. The result is exact, if it lies
+   in (lowerLimit, upperLimit]. Otherwise the pass stops as soon as
+   the result is known to be at most lowerLimit (then some value <=
+   lowerLimit is returned) or to exceed upperLimit (then some value >
+   upperLimit is returned). */
+int boundedUnionSize(TreeSetCursor *cursors, int numberOfSets, int treeVectorLength,
+                     const int *weights, int sumOfSizes, int lowerLimit, int upperLimit)
+{
+  int
+    i,
+    word = 0,
+    result = 0,
+    remaining = sumOfSizes;
+
+  boolean
+    hasBitmap = FALSE;
+
+  if(sumOfSizes <= lowerLimit)
+    return sumOfSizes;
+
+  FOR_0_LIMIT(i, numberOfSets)
+    {
+      cursors[i].position = 0;
+      hasBitmap |= cursors[i].set->bitmap != NULL;
+    }
+
+  while(word < treeVectorLength)
+    {
+      BitVector
+        united = 0;
+
+      int
+        next = treeVectorLength;
+
+      FOR_0_LIMIT(i, numberOfSets)
+        {
+          TreeSetCursor
+            *cursor = cursors + i;
+
+          const TreeSet
+            *set = cursor->set;
+
+          BitVector
+            bits = 0;
+
+          if(set->bitmap)
+            bits = set->bitmap[word];
+          else
+            {
+              while(cursor->position < set->cardinality
+                    && set->trees[cursor->position] / MASK_LENGTH == (uint32_t)word)
+                bits |= NTH_BIT(set->trees[cursor->position++]);
+
+              if(cursor->position < set->cardinality)
+                next = MIN(next, (int)(set->trees[cursor->position] / MASK_LENGTH));
+            }
+
+          united |= bits;
+          if(lowerLimit >= 0)
+            remaining -= weightedWordSize(bits, word, weights);
+        }
+
+      result += weightedWordSize(united, word, weights);
+
+      /* remaining bounds what the other words may add */
+      if(result > upperLimit)
+        return result;
+      if(lowerLimit >= 0 && result + remaining <= lowerLimit)
+        return result + remaining;
+
+      /* without bitmaps, the words in between are empty */
+      word = hasBitmap ? word + 1 : next;
+    }
+
+  return result;
+}
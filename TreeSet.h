@@ -0,0 +1,70 @@
+/*  RogueNaRok is an algorithm for the identification of rogue taxa in a set of phylogenetic trees. 
+ *
+ *  Moreover, the program collection comes with efficient implementations of 
+ *   * the unrooted leaf stability by Thorley and Wilkinson
+ *   * the taxonomic instability index by Maddinson and Maddison
+ *   * a maximum agreement subtree implementation (MAST) for unrooted trees 
+ *   * a tool for pruning taxa from a tree collection. 
+ * 
+ *  Copyright October 2011 by Andre J. Aberer
+ * 
+ *  Tree I/O and parallel framework are derived from RAxML by Alexandros Stamatakis.
+ *
+ *  This program is free software; you may redistribute it and/or
+ *  modify its under the terms of the GNU General Public License as
+ *  published by the Free Software Foundation; either version 2 of the
+ *  License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  For any other inquiries send an Email to Andre J. Aberer
+ *  andre.aberer at googlemail.com
+ * 
+ *  When publishing work that is based on the results from RogueNaRok, please cite:
+ *  Andre J. Aberer, Denis Krompaß, Alexandros Stamatakis. RogueNaRok: an Efficient and Exact Algorithm for Rogue Taxon Identification. (unpublished) 2011. 
+ * 
+ */
+
+
+#ifndef TREESET_H
+#define TREESET_H
+
+#include "common.h"
+#include "BitVector.h"
+
+/* the trees (columns) that contain a bipartition: a rare bipartition
+   has an ascending array of its trees, a frequent one a bitmap of (at
+   least) treeVectorLength words. A set switches to the bitmap, once
+   the array would be larger. */
+typedef struct
+{
+  uint32_t cardinality;
+  uint32_t capacity;            /* of the array */
+  uint32_t *trees;              /* if the set is sparse */
+  BitVector *bitmap;            /* if the set is dense */
+} TreeSet;
+
+/* a position in a tree set, for passes over several sets at once */
+typedef struct
+{
+  const TreeSet *set;
+  uint32_t position;
+} TreeSetCursor;
+
+void initTreeSet(TreeSet *set, const BitVector *bitVector, int numberOfTrees);
+void freeTreeSet(TreeSet *set);
+void addTreeToSet(TreeSet *set, uint32_t tree, int treeVectorLength);
+boolean isTreeInSet(const TreeSet *set, uint32_t tree);
+boolean removeTreeFromSet(TreeSet *set, uint32_t tree);
+void trimTreeSet(TreeSet *set);
+void treeSetToBitVector(const TreeSet *set, BitVector *bitVector, int treeVectorLength);
+uint32_t getTreesOfSet(const TreeSet *set, uint32_t *trees);
+void unionTreeSet(TreeSet *set, const TreeSet *other, int treeVectorLength);
+int weightedTreeSetSize(const TreeSet *set, int treeVectorLength, const int *weights);
+int boundedUnionSize(TreeSetCursor *cursors, int numberOfSets, int treeVectorLength,
+                     const int *weights, int sumOfSizes, int lowerLimit, int upperLimit);
+
+#endif
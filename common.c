@@ -151,10 +151,8 @@ char *lowerTheString(char *string)
 }
 
 
-FILE *getOutputFileFromString(char *fileName)
+void getOutputFileName(char *result, const char *fileName, const char *suffix)
 {
-
-  char result[1024];
   strcpy(result,         workdir);
 
   if(strcmp(workdir, ""))
@@ -166,7 +164,15 @@ FILE *getOutputFileFromString(char *fileName)
   strcat(result,         "_");
   strcat(result,         fileName);
   strcat(result,         ".");
-  strcat(result,         run_id);
+  strcat(result,         suffix);
+}
+
+
+FILE *getOutputFileFromString(char *fileName)
+{
+
+  char result[1024];
+  getOutputFileName(result, fileName, run_id);
 
   return  myfopen(result, "w");
 }
@@ -79,6 +79,7 @@ extern int processID;
 void  printVersionInfo(boolean toInfoFile);
 void printBothOpen(const char* format, ... );
 char *lowerTheString(char *string);
+void getOutputFileName(char *result, const char *fileName, const char *suffix);
 FILE *getOutputFileFromString(char *fileName);
 double gettime(void);
 void setupInfoFile(void);
@@ -32,125 +32,248 @@
 
 
 void freeHashTable(hashtable *h)
+{
+  uint32_t
+    i;
+
+  FOR_0_LIMIT(i, h->entryCount)
+    freeTreeSet(GET_ENTRY_TREESET(h, i));
+
+  free(h->slots);
+  free(h->slotHashes);
+  free(h->hashes);
+  free(h->bitVectorBlock);
+  free(h->treeSets);
+  free(h->bipNumbers);
+  free(h->bipNumbers2);
+}
+
+
+/* n is the number of entries expected, the table grows if needed */
+hashtable *initHashTable(uint32_t n, uint32_t vectorLength, uint32_t treeVectorLength)
+{
+  hashtable *h = (hashtable*)CALLOC(1,sizeof(hashtable));
+
+  uint32_t
+    tableSize = 64;
+
+  while(tableSize < 2 * n)
+    tableSize *= 2;
+
+  h->tableSize = tableSize;
+  h->slots = CALLOC(tableSize, sizeof(uint32_t));
+  h->slotHashes = CALLOC(tableSize, sizeof(uint64_t));
+
+  h->entryCount = 0;
+  h->capacity = MAX(n, 16);
+  h->vectorLength = vectorLength;
+  h->treeVectorLength = treeVectorLength;
+  h->hashes = CALLOC(h->capacity, sizeof(uint64_t));
+  h->bitVectors = reallocAlignedRows(&h->bitVectorBlock, NULL, 0, (size_t)h->capacity * vectorLength * sizeof(BitVector));
+  h->treeSets = CALLOC(h->capacity, sizeof(TreeSet));
+  h->bipNumbers = CALLOC(h->capacity, sizeof(uint32_t));
+  h->bipNumbers2 = CALLOC(h->capacity, sizeof(uint32_t));
+
+  return h;
+}
+
+
+/* returns the slot of the split or the empty slot where it belongs */
+static uint32_t findSlot(hashtable *h, const BitVector *bitVector, uint64_t hash)
+{
+  uint32_t
+    mask = h->tableSize - 1,
+    position = (uint32_t)hash & mask;
+
+  while(h->slots[position]
+        && (h->slotHashes[position] != hash
+            || memcmp(GET_ENTRY_BITVECTOR(h, h->slots[position] - 1), bitVector, h->vectorLength * sizeof(BitVector))))
+    position = (position + 1) & mask;
+
+  return position;
+}
+
+
+static void growSlots(hashtable *h)
 {
   uint32_t
     i,
-    entryCount = 0;   
+    mask;
 
-  for(i = 0; i < h->tableSize; i++)
+  free(h->slots);
+  free(h->slotHashes);
+
+  h->tableSize *= 2;
+  mask = h->tableSize - 1;
+  h->slots = CALLOC(h->tableSize, sizeof(uint32_t));
+  h->slotHashes = CALLOC(h->tableSize, sizeof(uint64_t));
+
+  FOR_0_LIMIT(i, h->entryCount)
     {
-      if(h->table[i] != NULL)
-	{
-	  entry *e = h->table[i];
-	  entry *previous;	 
-
-	  do
-	    {
-	      previous = e;
-	      e = e->next;
-
-	      if(previous->bitVector)
-		free(previous->bitVector);
-
-	      if(previous->treeVector)
-		free(previous->treeVector);
-
-	      if(previous->supportVector)
-		free(previous->supportVector);
-	      
-	      free(previous);	      
-	      entryCount++;
-	    }
-	  while(e != NULL);	  
-	}
+      uint32_t
+        position = (uint32_t)h->hashes[i] & mask;
 
+      while(h->slots[position])
+        position = (position + 1) & mask;
+
+      h->slots[position] = i + 1;
+      h->slotHashes[position] = h->hashes[i];
     }
+}
+
+
+static void growSlabs(hashtable *h)
+{
+  uint32_t
+    oldCapacity = h->capacity;
 
-  assert(entryCount == h->entryCount);
- 
-  free(h->table);
+  h->capacity *= 2;
+  h->hashes = realloc(h->hashes, h->capacity * sizeof(uint64_t));
+  h->bitVectors = reallocAlignedRows(&h->bitVectorBlock, h->bitVectors,
+                                     (size_t)oldCapacity * h->vectorLength * sizeof(BitVector),
+                                     (size_t)h->capacity * h->vectorLength * sizeof(BitVector));
+  h->treeSets = realloc(h->treeSets, h->capacity * sizeof(TreeSet));
+  h->bipNumbers = realloc(h->bipNumbers, h->capacity * sizeof(uint32_t));
+  h->bipNumbers2 = realloc(h->bipNumbers2, h->capacity * sizeof(uint32_t));
+
+  memset(h->treeSets + oldCapacity, 0, (h->capacity - oldCapacity) * sizeof(TreeSet));
+  memset(h->bipNumbers + oldCapacity, 0, (h->capacity - oldCapacity) * sizeof(uint32_t));
+  memset(h->bipNumbers2 + oldCapacity, 0, (h->capacity - oldCapacity) * sizeof(uint32_t));
 }
 
-hashtable *initHashTable(uint32_t n)
+
+/* returns the number of the entry of the split or -1 */
+int findEntry(hashtable *h, const BitVector *bitVector, uint64_t hash)
 {
-  static const  uint32_t initTable[] = {64, 128, 256, 512, 1024, 2048, 4096, 8192, 16384, 32768, 65536, 131072, 262144, 524288, 1048576, 2097152, 4194304, 8388608, 16777216, 33554432, 67108864, 134217728, 268435456, 536870912, 1073741824, 2147483648U};
-  
-  hashtable *h = (hashtable*)CALLOC(1,sizeof(hashtable));
-  
   uint32_t
-    tableSize,
-    i,
+    position = findSlot(h, bitVector, hash);
 
-#ifndef NDEBUG
-    maxSize = (uint32_t)-1,
-#endif
-    primeTableLength = sizeof(initTable)/sizeof(initTable[0]);
+  return h->slots[position] ? (int)(h->slots[position] - 1) : -1;
+}
 
-#ifndef NDEBUG
-  assert(n <= maxSize);
-#endif
 
-  i = 0;
+/* returns the number of the entry of the split, a new entry (with an
+   empty tree set) is appended if the split is not in the table */
+uint32_t findOrInsertEntry(hashtable *h, const BitVector *bitVector, uint64_t hash, boolean *inserted)
+{
+  uint32_t
+    position = findSlot(h, bitVector, hash),
+    result;
 
-  while(initTable[i] < n && i < primeTableLength)
-    i++;
-  
-  assert(i < primeTableLength);
+  *inserted = NOT h->slots[position];
+  if(NOT *inserted)
+    return h->slots[position] - 1;
 
-  tableSize = initTable[i];
+  if(h->entryCount == h->capacity)
+    growSlabs(h);
 
-  /* printf("Hash table init with size %u\n", tableSize); */
+  result = h->entryCount++;
+  h->hashes[result] = hash;
+  memcpy(GET_ENTRY_BITVECTOR(h, result), bitVector, h->vectorLength * sizeof(BitVector));
 
-  h->table = (entry**)CALLOC(tableSize, sizeof(entry*));
-  h->tableSize = tableSize;  
-  h->entryCount = 0;  
+  h->slots[position] = result + 1;
+  h->slotHashes[position] = hash;
 
-  return h;
+  /* keep the load factor below 1/2 */
+  if(2 * h->entryCount > h->tableSize)
+    growSlots(h);
+
+  return result;
 }
 
 
+/* the vectors of all nodes are rows of one arena (indexed by node
+   number), that is owned by bitVectors[0] */
 BitVector **initBitVector(All *tr, BitVector *vectorLength)
 {
   BitVector **bitVectors = (BitVector **)CALLOC(2 * tr->mxtips, sizeof(BitVector*));
+  BitVector *arena;
   int i;
 
   if(tr->mxtips % MASK_LENGTH == 0)
     *vectorLength = tr->mxtips / MASK_LENGTH;
   else
     *vectorLength = 1 + (tr->mxtips / MASK_LENGTH); 
-  
+
+  arena = (BitVector *)CALLOC(2 * tr->mxtips * (size_t)*vectorLength, sizeof(BitVector));
+
+  for(i = 0; i < 2 * tr->mxtips; i++)
+    bitVectors[i] = arena + (size_t)i * *vectorLength;
+
   for(i = 1; i <= tr->mxtips; i++)
-    {
-      bitVectors[i] = (BitVector *)CALLOC(*vectorLength, sizeof(BitVector));
-      bitVectors[i][(i - 1) / MASK_LENGTH] |= mask32[(i - 1) % MASK_LENGTH];
-    }
-  
-  for(i = tr->mxtips + 1; i < 2 * tr->mxtips; i++) 
-    bitVectors[i] = (BitVector *)CALLOC(*vectorLength, sizeof(BitVector));
+    bitVectors[i][(i - 1) / MASK_LENGTH] |= mask32[(i - 1) % MASK_LENGTH];
 
   return bitVectors;
 }
 
 
-ProfileElem *addProfileElem(entry *helem, int vectorLength,
-                            int treeVectorLength, int numberOfTrees) 
+void freeBitVectorArena(BitVector **bitVectors)
+{
+  free(bitVectors[0]);
+  free(bitVectors);
+}
+
+
+/* hands the bit vectors of the entries over to the caller, as rows of
+   stride words that start at a cache line. The caller frees *block,
+   the allocation they are in. The rows are widened in place (from the
+   last one on), s.t. there never are two copies of them. The table
+   cannot be searched any more, thus its slots are released, too. */
+BitVector *releaseBitVectors(hashtable *h, uint32_t stride, void **block)
 {
-  ProfileElem *result = CALLOC(1,sizeof(ProfileElem));
-  result->isInMLTree = FALSE; 
-  result->bitVector = CALLOC(vectorLength, sizeof(BitVector));
-  result->treeVector = CALLOC(treeVectorLength, sizeof(BitVector));
-  result->bitVector = memcpy(result->bitVector, helem->bitVector,
-                             vectorLength * sizeof(BitVector));
-  result->treeVector = memcpy(result->treeVector, helem->treeVector,
-                              treeVectorLength * sizeof(BitVector));
-
-  if(NTH_BIT_IS_SET(result->treeVector, numberOfTrees))
+  BitVector
+    *result = reallocAlignedRows(&h->bitVectorBlock, h->bitVectors,
+                                 (size_t)h->entryCount * h->vectorLength * sizeof(BitVector),
+                                 MAX((size_t)h->entryCount * stride, 1) * sizeof(BitVector));
+
+  uint32_t
+    i;
+
+  assert(stride >= h->vectorLength);
+
+  if(stride > h->vectorLength)
+    for(i = h->entryCount; i--; )
+      {
+        memmove(result + (size_t)i * stride, result + (size_t)i * h->vectorLength,
+                h->vectorLength * sizeof(BitVector));
+        memset(result + (size_t)i * stride + h->vectorLength, 0,
+               (stride - h->vectorLength) * sizeof(BitVector));
+      }
+
+  free(h->slots);
+  free(h->slotHashes);
+  h->slots = NULL;
+  h->slotHashes = NULL;
+  *block = h->bitVectorBlock;
+  h->bitVectors = NULL;
+  h->bitVectorBlock = NULL;
+
+  return result;
+}
+
+
+/* fills the elements of profile (whose taxon vectors already are those
+   of the entries) with the entries of the split table, that hands its
+   tree sets over */
+void addProfileElems(hashtable *h, Array *profile, int numberOfTrees, const int *treeWeights)
+{
+  uint32_t
+    i;
+
+  assert((uint32_t)profile->length == h->entryCount);
+
+  FOR_0_LIMIT(i, h->entryCount)
     {
-      result->isInMLTree = TRUE;
-      UNFLIP_NTH_BIT(result->treeVector, numberOfTrees);
-    }
-  
-  result->treeVectorSupport = genericBitCount(result->treeVector, treeVectorLength);
+      ProfileElem
+        *elem = GET_PROFILE_ELEM(profile, i);
 
-  return result; 
+      elem->fingerprint = h->hashes[i];
+      elem->treeSet = *GET_ENTRY_TREESET(h, i);
+      memset(GET_ENTRY_TREESET(h, i), 0, sizeof(TreeSet));
+
+      /* the tree after the last one is the best tree */
+      elem->isInMLTree = removeTreeFromSet(&elem->treeSet, numberOfTrees);
+      trimTreeSet(&elem->treeSet);
+      elem->treeVectorSupport = weightedTreeSetSize(&elem->treeSet, GET_BITVECTOR_LENGTH(numberOfTrees), treeWeights);
+    }
 }
@@ -39,18 +39,6 @@
 
 #define NUM_BRANCHES   128
 
-typedef struct ent
-{
-  uint32_t *bitVector;
-  uint32_t *treeVector;
-  uint32_t amountTips;
-  int *supportVector;
-  uint32_t bipNumber;
-  uint32_t bipNumber2;
-  uint32_t supportFromTreeset[2]; 
-  struct ent *next;
-} entry;
-
 typedef struct
 {
   uint32_t *vector; 
@@ -61,31 +49,23 @@ typedef struct
 
 typedef  struct noderec
 {
-  uint32_t    isPresent[NUM_BRANCHES / MASK_LENGTH];
-  struct noderec  *backs[NUM_BRANCHES];
-  char            xs[NUM_BRANCHES];
-  branchInfo      *bInf;
-  double           z[NUM_BRANCHES];
   struct noderec  *next;
   struct noderec  *back;
-  uint32_t   hash;
+  branchInfo      *bInf;
+  double          *z;       /* branch lengths, allocated on first use */
+  uint64_t   hash;          /* fingerprint of the taxa below */
   int              support;
   int              number;
   char             x;
-  double **insertionLWs;
 } node, *nodeptr;
 
-typedef struct stringEnt
-{
-  int nodeNumber;
-  char *word;
-  struct stringEnt *next;
-} stringEntry ;
-
 typedef struct
 {
-  uint32_t tableSize;
-  stringEntry **table;
+  uint32_t tableSize;           /* a power of two */
+  uint32_t entryCount;
+  uint32_t *hashes;
+  int *nodeNumbers;             /* 0 marks an empty slot */
+  char **words;
 }  stringHashtable;
 
 
@@ -94,6 +74,8 @@ typedef struct _All
   nodeptr start;
   int mxtips;
   int numberOfTrees;
+  int numberOfTreeColumns;      /* distinct topologies among the trees */
+  int *treeWeights;             /* trees per column, NULL if all are distinct */
   int bitVectorLength;
   nodeptr p0;
   nodeptr *nodep;
@@ -111,13 +93,30 @@ typedef struct _All
   double fracchange;
 } All;
 
+/* split table: open addressing (linear probing) over slots that
+   refer to entries. The entries are stored in slabs in the order of
+   their insertion, entry i owns the i-th bit vector, tree set etc.
+   The bitmaps of the tree sets have treeVectorLength words. */
 typedef struct
 {
-  uint32_t tableSize;
-  entry **table;
+  uint32_t tableSize;           /* number of slots, a power of two */
+  uint32_t *slots;              /* entry number + 1, 0 if empty */
+  uint64_t *slotHashes;         /* hash of the entry in each slot */
   uint32_t entryCount;
+  uint32_t capacity;            /* entries the slabs have room for */
+  uint32_t vectorLength;
+  uint32_t treeVectorLength;
+  uint64_t *hashes;             /* fingerprints of the bit vectors */
+  BitVector *bitVectors;        /* rows, aligned by reallocAlignedRows */
+  void *bitVectorBlock;         /* the allocation bitVectors are in */
+  TreeSet *treeSets;
+  uint32_t *bipNumbers;
+  uint32_t *bipNumbers2;
 }  hashtable;
 
+#define GET_ENTRY_BITVECTOR(h,i) ((h)->bitVectors + (size_t)(i) * (h)->vectorLength)
+#define GET_ENTRY_TREESET(h,i) ((h)->treeSets + (i))
+
 
 #define FC_INIT               20
 #define zmin       1.0E-15  /* max branch prop. to -log(zmin) (= 34) */
@@ -130,15 +129,18 @@ typedef struct
 #define BIPARTITIONS_RF  4
 #define defaultz       0.9         /* value of z assigned as starting point */
 #define nmlngth        1024         /* number of characters in species name */
-#define VECTOR_LENGTH (NUM_BRANCHES / MASK_LENGTH)
 
 void bitVectorInitravSpecial(uint32_t **bitVectors, nodeptr p, int numsp, uint32_t vectorLength, hashtable *h, int treeNumber, int function, branchInfo *bInf, int *countBranches, int treeVectorLength, boolean traverseOnly, boolean computeWRF);
-hashtable *initHashTable(uint32_t n);
+hashtable *initHashTable(uint32_t n, uint32_t vectorLength, uint32_t treeVectorLength);
 void freeHashTable(hashtable *h);
-ProfileElem *addProfileElem(entry *helem, int vectorLength, int treeVectorLength, int numberOfTrees) ;
+int findEntry(hashtable *h, const BitVector *bitVector, uint64_t hash);
+uint32_t findOrInsertEntry(hashtable *h, const BitVector *bitVector, uint64_t hash, boolean *inserted);
+BitVector *releaseBitVectors(hashtable *h, uint32_t stride, void **block);
+void addProfileElems(hashtable *h, Array *profile, int numberOfTrees, const int *treeWeights);
 
 
-BitVector *neglectThoseTaxa(All *tr, const char *toDrop);
+BitVector *neglectThoseTaxa(All *tr, const char * const *toDrop, int numberOfNames);
 void pruneTaxon(All *tr, uint32_t k, boolean considerBranchLengths);
 BitVector **initBitVector(All *tr, BitVector *vectorLength);
+void freeBitVectorArena(BitVector **bitVectors);
 #endif
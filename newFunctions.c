@@ -30,20 +30,34 @@
 
 #include "newFunctions.h"
 
-IndexList *parseToDrop(All *tr, FILE *toDrop)
+#ifndef WIN32
+#include <pthread.h>
+#endif
+
+/* reads the names of taxa (one per line) that must not be dropped */
+char **parseToDrop(FILE *toDrop, int *numberOfNames)
 {
-  IndexList
-    *result = NULL;
+  int
+    capacity = 16;
 
   char
+    **result = CALLOC(capacity, sizeof(char*)),
     line[1024];
 
+  *numberOfNames = 0;
+
   while(fgets(line, 1024, toDrop) != NULL)
     {
       char bla[1024];
-      sscanf(line, "%s\n", bla);
-      PR("will drop %d\n", treeFindTipByLabelString(bla, tr));
-      result = appendToIndexList(treeFindTipByLabelString(bla, tr), result);
+      if(sscanf(line, "%s\n", bla) != 1)
+        continue;
+
+      if(*numberOfNames == capacity)
+        {
+          capacity *= 2;
+          result = realloc(result, capacity * sizeof(char*));
+        }
+      result[(*numberOfNames)++] = strdup(bla);
     }
 
   return result;
@@ -70,7 +84,9 @@ void pruneTaxon(All *tr, uint32_t k, boolean considerBranchLengths)
 }
 
 
-BitVector *neglectThoseTaxa(All *tr, const char *toDrop)
+/* returns the taxa that may be dropped, or NULL, if a name is not a
+   taxon of the trees */
+BitVector *neglectThoseTaxa(All *tr, const char * const *toDrop, int numberOfNames)
 {
   int
     i = 0;
@@ -81,103 +97,528 @@ BitVector *neglectThoseTaxa(All *tr, const char *toDrop)
   for(i = 0; i < tr->mxtips; i++)
     FLIP_NTH_BIT(result,i);
 
-  if(strlen(toDrop) == 0)
-    return result;
+  FOR_0_LIMIT(i, numberOfNames)
+    {
+      int
+        taxon = treeFindTipByLabelString((char*)toDrop[i], tr);
+
+      if(taxon <= 0)
+        {
+          PR("ERROR: Taxon %s that must not be dropped is not part of the trees.\n", toDrop[i]);
+          free(result);
+          return NULL;
+        }
 
-  FILE
-    *toDropFile = myfopen(toDrop,"r");
+      PR("will drop %d\n", taxon);
+
+      UNFLIP_NTH_BIT(result, (taxon -1) );
+      assert( NOT NTH_BIT_IS_SET(result, taxon -1 ));
+    }
+
+  return result;
+}
+
+
+static uint64_t mixSplitNumber(uint64_t x)
+{
+  x += 0x9E3779B97F4A7C15ULL;
+  x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+  return x ^ (x >> 31);
+}
+
+
+/* whether the tree, whose splits ex lists, has the same splits as the
+   tree other that is in h already. The splits of ex are distinct,
+   thus it suffices that other has as many splits and all of those of
+   ex. */
+static boolean hasSplitsOfTree(SplitExtractor *ex, hashtable *h, int other, int numberOfSplitsOfOther)
+{
+  int
+    i;
 
-  IndexList
-    *iter,
-    *toConvert = parseToDrop(tr, toDropFile);
+  if(ex->numberOfSplits != numberOfSplitsOfOther)
+    return FALSE;
 
-  for(iter = toConvert; iter; iter = iter->next)
+  FOR_0_LIMIT(i, ex->numberOfSplits)
     {
-      UNFLIP_NTH_BIT(result, (iter->index -1) );
-      assert( NOT NTH_BIT_IS_SET(result, iter->index -1 ));
+      int
+        e = findEntry(h, ex->splits + (size_t)i * ex->vectorLength, ex->splitHashes[i]);
+
+      if(e < 0 || NOT isTreeInSet(GET_ENTRY_TREESET(h, e), other))
+        return FALSE;
     }
 
-  freeIndexList(toConvert);
+  return TRUE;
+}
 
-  return result;
+
+/* inserts the bipartitions of trees [firstTree, lastTree) into h.
+   Trees that are textually identical to an earlier tree are skipped.
+   A tree with the same splits as an earlier tree of the range is
+   found by the sum of its split hashes before its splits are
+   inserted; it is not inserted either, but marked in identicalTrees
+   as a copy of that tree. The sum and the number of splits of each
+   inserted tree are kept in signatures and numberOfSplits. */
+static void addBipartitionsOfTrees(SplitExtractor *ex, All *tr, TreeFile *treeFile, int *identicalTrees,
+                                   uint64_t *signatures, int *numberOfSplits,
+                                   int firstTree, int lastTree, hashtable *h)
+{
+  int
+    i,
+    j,
+    numberOfTrees = lastTree - firstTree;
+
+  uint32_t
+    position,
+    tableSize = 64,
+    mask,
+    *table;
+
+  /* table entries are tree numbers (relative to firstTree) + 1 */
+  while(tableSize < 2 * (uint32_t)numberOfTrees)
+    tableSize *= 2;
+  mask = tableSize - 1;
+  table = CALLOC(tableSize, sizeof(uint32_t));
+
+  FOR_N_LIMIT(i, firstTree, lastTree)
+    {
+      uint64_t
+        signature = 0;
+
+      if(identicalTrees[i] != i)
+        continue;
+
+      readBootstrapSplits(ex, tr, treeFile, i);
+
+      FOR_0_LIMIT(j, ex->numberOfSplits)
+        signature += mixSplitNumber(ex->splitHashes[j]);
+
+      for(position = signature & mask; table[position]; position = (position + 1) & mask)
+        {
+          int
+            other = table[position] - 1;
+
+          if(signatures[firstTree + other] == signature
+             && hasSplitsOfTree(ex, h, firstTree + other, numberOfSplits[firstTree + other]))
+            break;
+        }
+
+      if(table[position])
+        {
+          identicalTrees[i] = firstTree + table[position] - 1;
+          continue;
+        }
+
+      table[position] = i - firstTree + 1;
+      signatures[i] = signature;
+      numberOfSplits[i] = ex->numberOfSplits;
+
+      FOR_0_LIMIT(j, ex->numberOfSplits)
+        {
+          boolean
+            inserted;
+
+          uint32_t
+            e = findOrInsertEntry(h, ex->splits + (size_t)j * ex->vectorLength, ex->splitHashes[j], &inserted);
+
+          if(inserted)
+            h->bipNumbers[e] = e;
+
+          addTreeToSet(GET_ENTRY_TREESET(h, e), i, h->treeVectorLength);
+        }
+    }
+
+  free(table);
 }
 
 
-Array *getOriginalBipArray(All *tr, FILE *bestTree, FILE *treeFile)
+#ifndef WIN32
+typedef struct
 {
-  Array *result = CALLOC(1, sizeof(Array));
+  All *tr;
+  SplitExtractor *extractor;
+  TreeFile *treeFile;
+  int *identicalTrees;
+  uint64_t *signatures;
+  int *numberOfSplits;
+  int firstTree;
+  int lastTree;
+  hashtable *htable;
+} profileShard;
+
+
+static void *buildProfileShard(void *arg)
+{
+  profileShard
+    *shard = (profileShard*)arg;
+
+  addBipartitionsOfTrees(shard->extractor, shard->tr, shard->treeFile, shard->identicalTrees,
+                         shard->signatures, shard->numberOfSplits,
+                         shard->firstTree, shard->lastTree, shard->htable);
+
+  return NULL;
+}
+
+
+/* moves the entries of a thread-local table into h. Entries are
+   processed in the order of their creation, thus the result is the
+   same as if the trees of the shard had been inserted into h
+   directly. */
+static void mergeProfileShard(hashtable *h, hashtable *local)
+{
+  uint32_t
+    i;
+
+  assert(h->vectorLength == local->vectorLength && h->treeVectorLength == local->treeVectorLength);
+
+  FOR_0_LIMIT(i, local->entryCount)
+    {
+      boolean
+        inserted;
+
+      uint32_t
+        e = findOrInsertEntry(h, GET_ENTRY_BITVECTOR(local, i), local->hashes[i], &inserted);
+
+      TreeSet
+        *treeSet = GET_ENTRY_TREESET(h, e),
+        *toMerge = GET_ENTRY_TREESET(local, i);
+
+      /* a new entry takes over the set */
+      if(inserted)
+        {
+          h->bipNumbers[e] = e;
+          *treeSet = *toMerge;
+          memset(toMerge, 0, sizeof(TreeSet));
+        }
+      else
+        unionTreeSet(treeSet, toMerge, h->treeVectorLength);
+    }
+
+  freeHashTable(local);
+  free(local);
+}
+
 
+/* the shards only know the copies of a tree within themselves. A tree
+   that has the same splits as a tree of an earlier shard is removed
+   from the sets of its splits and marked as a copy of that tree, as
+   the serial builder would have done. Its splits are all in the
+   earlier tree, thus no bipartition is lost or changes its place. */
+static void collapseCopiesAcrossShards(SplitExtractor *ex, All *tr, TreeFile *treeFile, int *identicalTrees,
+                                       const uint64_t *signatures, const int *numberOfSplits, hashtable *h)
+{
   int
-    i,j,bCount = 0,
-    treeVectorLength = GET_BITVECTOR_LENGTH((tr->numberOfTrees+1));
+    i,
+    j;
+
   uint32_t
-    vectorLength = 0,
-    **setBitVectors = initBitVector(tr, &vectorLength);
-  hashtable
-    *setHtable =  initHashTable(tr->mxtips * FC_INIT * 10);
-  nodeptr
-    commonStart = NULL;
+    position,
+    tableSize = 64,
+    mask,
+    *table;
+
+  /* table entries are tree numbers + 1 */
+  while(tableSize < 2 * (uint32_t)tr->numberOfTrees)
+    tableSize *= 2;
+  mask = tableSize - 1;
+  table = CALLOC(tableSize, sizeof(uint32_t));
+
+  FOR_0_LIMIT(i, tr->numberOfTrees)
+    {
+      boolean
+        isCopy = FALSE;
+
+      if(identicalTrees[i] != i)
+        continue;
+
+      for(position = signatures[i] & mask; table[position]; position = (position + 1) & mask)
+        {
+          int
+            other = table[position] - 1;
+
+          if(signatures[other] != signatures[i] || numberOfSplits[other] != numberOfSplits[i])
+            continue;
+
+          readBootstrapSplits(ex, tr, treeFile, i);
+          if(hasSplitsOfTree(ex, h, other, numberOfSplits[other]))
+            {
+              isCopy = TRUE;
+              break;
+            }
+        }
+
+      if(NOT isCopy)
+        {
+          table[position] = i + 1;
+          continue;
+        }
+
+      FOR_0_LIMIT(j, ex->numberOfSplits)
+        {
+          int
+            e = findEntry(h, ex->splits + (size_t)j * ex->vectorLength, ex->splitHashes[j]);
+
+          assert(e >= 0);
+          removeTreeFromSet(GET_ENTRY_TREESET(h, e), i);
+        }
+
+      identicalTrees[i] = table[position] - 1;
+    }
 
-  BitVector
-    lastByte = 0;
+  free(table);
+}
 
-  for(i = tr->mxtips; i < MASK_LENGTH * vectorLength; ++i)
-    lastByte |= mask32[i % MASK_LENGTH];
+
+/* shards the trees by file offset, such that every thread parses
+   about the same amount of input. The tables of the shards are merged
+   in the order of the shards, then copies of trees in different
+   shards are collapsed. The result is the table of the serial
+   builder. */
+static void addBipartitionsOfTreesParallel(All *tr, TreeFile *treeFile, int *identicalTrees,
+                                           uint64_t *signatures, int *numberOfSplits,
+                                           int referenceTip, int numberOfThreads, hashtable *h)
+{
+  int
+    i,
+    tree = 0,
+    numberOfShards = MIN(numberOfThreads, tr->numberOfTrees);
+
+  size_t
+    span = treeFile->treeOffsets[tr->numberOfTrees];
+
+  profileShard
+    *shards = CALLOC(numberOfShards, sizeof(profileShard));
+
+  pthread_t
+    *threads = CALLOC(numberOfShards, sizeof(pthread_t));
+
+  boolean
+    *running = CALLOC(numberOfShards, sizeof(boolean));
+
+  FOR_0_LIMIT(i, numberOfShards)
+    {
+      profileShard
+        *shard = shards + i;
+
+      shard->tr = tr;
+      shard->extractor = createSplitExtractor(tr, referenceTip);
+      shard->treeFile = treeFile;
+      shard->identicalTrees = identicalTrees;
+      shard->signatures = signatures;
+      shard->numberOfSplits = numberOfSplits;
+      shard->htable = initHashTable(h->capacity, h->vectorLength, h->treeVectorLength);
+      shard->firstTree = tree;
+
+      if(i == numberOfShards - 1)
+        tree = tr->numberOfTrees;
+      else
+        {
+          size_t
+            limit = span / numberOfShards * (i + 1);
+
+          do
+            tree++;
+          while(tree < tr->numberOfTrees - (numberOfShards - 1 - i) && treeFile->treeOffsets[tree] < limit);
+        }
+
+      shard->lastTree = tree;
+    }
+
+  /* this thread builds the first shard and those, for which no thread
+     could be started */
+  for(i = 1; i < numberOfShards; ++i)
+    running[i] = pthread_create(threads + i, NULL, buildProfileShard, shards + i) == 0;
+
+  FOR_0_LIMIT(i, numberOfShards)
+    if(NOT running[i])
+      buildProfileShard(shards + i);
+
+  FOR_0_LIMIT(i, numberOfShards)
+    {
+      if(running[i])
+        pthread_join(threads[i], NULL);
+      mergeProfileShard(h, shards[i].htable);
+    }
+
+  collapseCopiesAcrossShards(shards[0].extractor, tr, treeFile, identicalTrees, signatures, numberOfSplits, h);
+
+  FOR_0_LIMIT(i, numberOfShards)
+    freeSplitExtractor(shards[i].extractor);
+  free(running);
+  free(threads);
+  free(shards);
+}
+#endif
+
+
+/* allocates a profile for length bipartitions together with the
+   attributes common to all of them. The bipartitions live in the
+   store of the attributes, the profile refers to them in the order of
+   their ids. The store takes over bitVectors (rows of the kernel
+   width that start at a cache line) and slab, the allocation they are
+   in, if given. */
+Array *createBipartitionProfile(All *tr, uint32_t length, BitVector *bitVectors, void *slab)
+{
+  Array *result = CALLOC(1, sizeof(Array));
 
   uint32_t
-    *randForTaxa = CALLOC(tr->mxtips, sizeof(uint32_t));
+    i,
+    vectorLength = GET_BITVECTOR_LENGTH(tr->mxtips);
 
+  ProfileElemAttr
+    *attr = CALLOC(1, sizeof(ProfileElemAttr));
+
+  attr->bitVectorLength = vectorLength;
+  attr->treeVectorLength = GET_BITVECTOR_LENGTH((tr->numberOfTreeColumns+1));
+  for(i = tr->mxtips; i < MASK_LENGTH * vectorLength; ++i)
+    attr->lastByte |= mask32[i % MASK_LENGTH];
+
+  /* the random numbers once used to hash the bipartitions are still
+     drawn, s.t. a seed gives the same dropset hashes as before */
   for(i = tr->mxtips; i--; )
-    randForTaxa[i] = UINT32_MAX * unif_rand();
+    unif_rand();
 
-  rewind(treeFile);
+  result->commonAttributes = attr;
+  result->hasCommonAttributes = 1;
+  attr->store = createBipartitionStore(length, getKernelBitVectorLength(tr->mxtips), bitVectors, slab);
 
-  if(bestTree)
-    rewind(bestTree);
+  result->length = length;
+  result->arrayTable = CALLOC(length, sizeof(ProfileElem*));
+  FOR_0_LIMIT(i, length)
+    ((ProfileElem**)result->arrayTable)[i] = attr->store->elems + i;
+
+  return result;
+}
+
+
+/* gives each distinct tree a column and renumbers the tree sets of all
+   bipartitions accordingly. The weight of a column is the number of
+   trees it stands for: the tree itself and the trees that
+   identicalTrees marks as its copies (these are not in the sets). The
+   best tree becomes the column after the last column. */
+static void collapseIdenticalTrees(All *tr, hashtable *h, const int *identicalTrees)
+{
+  int
+    i,
+    n = tr->numberOfTrees,
+    numberOfColumns = 0,
+    *columnOf = CALLOC(n + 1, sizeof(int)),
+    *weights = CALLOC(n, sizeof(int));
 
-  /* get bipartitions of bootstrap set */
-  for( i = 1; i <= tr->numberOfTrees; ++i)
+  uint32_t
+    j,
+    member,
+    *trees;
+
+  FOR_0_LIMIT(i, n)
     {
-      readBootstrapTree(tr, treeFile);
+      if(identicalTrees[i] == i)
+        columnOf[i] = numberOfColumns++;
+      else
+        columnOf[i] = columnOf[identicalTrees[i]];
+      weights[columnOf[i]]++;
+    }
+  columnOf[n] = numberOfColumns;
 
-      if( NOT commonStart)
-        commonStart = tr->start;
-      bCount = 0;
-      bitVectorInitravSpecial(setBitVectors, commonStart->back, tr->mxtips, vectorLength, setHtable, (i - 1), BIPARTITIONS_BOOTSTOP, (branchInfo *)NULL, &bCount, treeVectorLength, FALSE, FALSE);
+  if(numberOfColumns < n)
+    {
+      BitVector
+        *columns = CALLOC(GET_BITVECTOR_LENGTH((numberOfColumns + 1)), sizeof(BitVector));
+
+      trees = CALLOC(n + 1, sizeof(uint32_t));
+
+      /* the sets are rebuilt with the columns of their trees */
+      FOR_0_LIMIT(j, h->entryCount)
+        {
+          TreeSet
+            *treeSet = GET_ENTRY_TREESET(h, j);
+
+          uint32_t
+            count = getTreesOfSet(treeSet, trees);
+
+          memset(columns, 0, GET_BITVECTOR_LENGTH((numberOfColumns + 1)) * sizeof(BitVector));
+          FOR_0_LIMIT(member, count)
+            FLIP_NTH_BIT(columns, columnOf[trees[member]]);
+
+          freeTreeSet(treeSet);
+          initTreeSet(treeSet, columns, numberOfColumns + 1);
+        }
+
+      free(columns);
+      free(trees);
+      h->treeVectorLength = GET_BITVECTOR_LENGTH((numberOfColumns + 1));
+
+      tr->numberOfTreeColumns = numberOfColumns;
+      tr->treeWeights = realloc(weights, numberOfColumns * sizeof(int));
+      weights = NULL;
+    }
+
+  free(weights);
+  free(columnOf);
+}
+
+
+/* builds the bipartition profile of the trees, with numberOfThreads
+   threads if more than one */
+Array *getOriginalBipArray(All *tr, TreeFile *bestTree, TreeFile *treeFile, int numberOfThreads)
+{
+  Array *result;
+
+  int
+    i,bCount = 0,
+    treeVectorLength = GET_BITVECTOR_LENGTH((tr->numberOfTrees+1));
+  uint32_t
+    vectorLength = 0,
+    **setBitVectors = initBitVector(tr, &vectorLength);
+  hashtable
+    *setHtable =  initHashTable(tr->mxtips * FC_INIT, vectorLength, treeVectorLength);
+  int
+    referenceTip = 1,
+    *identicalTrees = findIdenticalTrees(treeFile),
+    *numberOfSplits = CALLOC(MAX(tr->numberOfTrees, 1), sizeof(int));
+  uint64_t
+    *signatures = CALLOC(MAX(tr->numberOfTrees, 1), sizeof(uint64_t));
+  BitVector
+    *bitVectors;
+  void
+    *slab;
+
+  /* get bipartitions of bootstrap set. All splits are oriented away
+     from the first taxon. */
+#ifndef WIN32
+  if(numberOfThreads > 1 && tr->numberOfTrees > 1)
+    addBipartitionsOfTreesParallel(tr, treeFile, identicalTrees, signatures, numberOfSplits,
+                                   referenceTip, numberOfThreads, setHtable);
+  else
+#endif
+    {
+      SplitExtractor
+        *extractor = createSplitExtractor(tr, referenceTip);
+      addBipartitionsOfTrees(extractor, tr, treeFile, identicalTrees, signatures, numberOfSplits,
+                             0, tr->numberOfTrees, setHtable);
+      freeSplitExtractor(extractor);
     }
+  free(signatures);
+  free(numberOfSplits);
 
   if(bestTree)
     {
       readBestTree(tr,bestTree);
 
       bCount = 0;
-      bitVectorInitravSpecial(setBitVectors, commonStart->back, tr->mxtips, vectorLength, setHtable, tr->numberOfTrees, BIPARTITIONS_BOOTSTOP, (branchInfo *)NULL, &bCount, treeVectorLength, FALSE, FALSE);
+      bitVectorInitravSpecial(setBitVectors, tr->nodep[referenceTip]->back, tr->mxtips, vectorLength, setHtable, tr->numberOfTrees, BIPARTITIONS_BOOTSTOP, (branchInfo *)NULL, &bCount, treeVectorLength, FALSE, FALSE);
       assert(bCount == tr->mxtips - 3);
     }
 
-  result->commonAttributes = CALLOC(1, sizeof(ProfileElemAttr));
-  result->hasCommonAttributes = 1;
-  ((ProfileElemAttr*)result->commonAttributes)->bitVectorLength = vectorLength;
-  ((ProfileElemAttr*)result->commonAttributes)->treeVectorLength = treeVectorLength;
-  ((ProfileElemAttr*)result->commonAttributes)->lastByte = lastByte;
-  ((ProfileElemAttr*)result->commonAttributes)->randForTaxa = randForTaxa;
-  result->length = setHtable->entryCount;
-  result->arrayTable = CALLOC(result->length, sizeof(ProfileElem*));
-
-  j = 0;
-  for(i = 0; i < setHtable->tableSize; ++i)
-    {
-      entry
-	*elem = setHtable->table[i];
-
-      while(elem)
-	{
-	  ((ProfileElem**)result->arrayTable)[j] = addProfileElem(elem, vectorLength, treeVectorLength, tr->numberOfTrees);
-	  j++;
-	  elem = elem->next;
-	}
-    }
-  assert(j == setHtable->entryCount);
+  collapseIdenticalTrees(tr, setHtable, identicalTrees);
+  free(identicalTrees);
+
+  /* the profile lists the bipartitions in the order of their first
+     occurrence, its store takes over the bit vectors of the table */
+  bitVectors = releaseBitVectors(setHtable, getKernelBitVectorLength(tr->mxtips), &slab);
+  result = createBipartitionProfile(tr, setHtable->entryCount, bitVectors, slab);
+  addProfileElems(setHtable, result, tr->numberOfTreeColumns, tr->treeWeights);
 
   int cnt= 0;
   for(i = 0; i < result->length; ++i)
@@ -187,15 +628,8 @@ Array *getOriginalBipArray(All *tr, FILE *bestTree, FILE *treeFile)
     assert(cnt == tr->mxtips - 3);
 
   freeHashTable(setHtable);
-  freeBitVectors(setBitVectors, 2 * tr->mxtips);
-  free(setBitVectors);
+  freeBitVectorArena(setBitVectors);
   free(setHtable);
-  free(randForTaxa);
-
-  /* TEST */
-  for(i = 0; i < result->length; ++i )
-    ((ProfileElem**)result->arrayTable)[i]->id  = i;
-  /* END */
 
   return result;
 }
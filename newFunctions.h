@@ -39,9 +39,10 @@
 #include "Tree.h"
 #include "ProfileElem.h"
 
-IndexList *parseToDrop(All *tr, FILE *toDrop);
+char **parseToDrop(FILE *toDrop, int *numberOfNames);
 void pruneTaxon(All *tr, uint32_t k, boolean considerBranchLengths) ;
-BitVector *neglectThoseTaxa(All *tr, const char *toDrop);
-Array *getOriginalBipArray(All *tr, FILE *bestTree, FILE *treeFile) ;
+BitVector *neglectThoseTaxa(All *tr, const char * const *toDrop, int numberOfNames);
+Array *createBipartitionProfile(All *tr, uint32_t length, BitVector *bitVectors, void *slab);
+Array *getOriginalBipArray(All *tr, TreeFile *bestTree, TreeFile *treeFile, int numberOfThreads);
 
 #endif